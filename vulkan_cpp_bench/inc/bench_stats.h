@@ -0,0 +1,40 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef bench_stats_h
+#define bench_stats_h
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace vtpl::bench
+{
+/**
+    Print the mean and quantiles of a set of samples in microseconds, one line per case.
+*/
+inline void report(const std::string& name, std::vector<std::chrono::nanoseconds> samples)
+{
+    if (samples.empty())
+    {
+        std::cout << name << ": no samples" << std::endl;
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    std::chrono::nanoseconds total{0};
+    for (std::chrono::nanoseconds sample : samples)
+    {
+        total += sample;
+    }
+    auto us = [](std::chrono::nanoseconds duration) { return static_cast<double>(duration.count()) / 1e3; };
+    auto quantile = [&](double q) { return us(samples[static_cast<size_t>(q * (samples.size() - 1))]); };
+    std::cout << name << ": " << samples.size() << " samples, us mean " << us(total) / samples.size() << ", p50 "
+              << quantile(0.5) << ", p99 " << quantile(0.99) << ", max " << us(samples.back()) << std::endl;
+}
+} // namespace vtpl::bench
+
+#endif // bench_stats_h
@@ -0,0 +1,133 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "bench_stats.h"
+#include "engine.h"
+#include "gpu_memory.h"
+#include "gpu_reactor.h"
+#include "gpu_task.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <semaphore>
+#include <string>
+#include <vector>
+
+namespace
+{
+// every job fills a slice of its own, so concurrent jobs never touch the same bytes
+constexpr vk::DeviceSize sliceSize = 64 * 1024;
+constexpr uint32_t       jobCount = 64;
+
+vtpl::Task<void> submit_once(vtpl::GpuReactor& reactor, vk::CommandBuffer commandBuffer)
+{
+    co_await reactor.submit(commandBuffer);
+}
+
+vtpl::Task<void> submit_counted(vtpl::GpuReactor& reactor, vk::CommandBuffer commandBuffer,
+                                std::atomic<uint32_t>& remaining, std::binary_semaphore& done)
+{
+    co_await reactor.submit(commandBuffer);
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        done.release();
+    }
+}
+
+void report_throughput(const std::string& name, uint32_t jobs, std::chrono::nanoseconds total)
+{
+    const double seconds = static_cast<double>(total.count()) / 1e9;
+    std::cout << name << ": " << jobs << " jobs in " << seconds * 1e3 << " ms, " << jobs / seconds << " jobs/s"
+              << std::endl;
+}
+} // namespace
+
+/*
+ * Compares GpuReactor with a blocking submit and fence wait, as Engine::immediate_submit does,
+ * on the same small fills: the latency of one job at a time, and the throughput of 64 jobs in
+ * flight at once, which the blocking submit can only run one after the other. Both sides
+ * submit the same pre-recorded command buffers, so only the way of waiting differs.
+ *
+ * usage: vulkan_reactor_bench [rounds]
+ */
+int main(int argc, char const* argv[])
+{
+    const uint32_t rounds = argc > 1 ? static_cast<uint32_t>(std::max(1, std::atoi(argv[1]))) : 50;
+
+    std::unique_ptr<Engine> const engine(new Engine());
+    const vk::Device&             device = engine->get_device();
+
+    vtpl::Buffer target = vtpl::make_buffer(*engine, sliceSize * jobCount, vk::BufferUsageFlagBits::eTransferDst,
+                                            vk::MemoryPropertyFlagBits::eDeviceLocal);
+    vk::CommandPool commandPool = device.createCommandPool(
+        vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlags(), engine->get_queue_family_index()));
+    const std::vector<vk::CommandBuffer> commandBuffers = device.allocateCommandBuffers(
+        vk::CommandBufferAllocateInfo(commandPool, vk::CommandBufferLevel::ePrimary, jobCount));
+    for (uint32_t job = 0; job < jobCount; job++)
+    {
+        // recorded once and submitted again every round
+        commandBuffers[job].begin(vk::CommandBufferBeginInfo());
+        commandBuffers[job].fillBuffer(target.buffer, sliceSize * job, sliceSize, job);
+        commandBuffers[job].end();
+    }
+    vk::Fence fence = device.createFence(vk::FenceCreateInfo());
+    auto      fill = [&](uint32_t job)
+    {
+        vk::SubmitInfo submitInfo = vk::SubmitInfo(0, nullptr, nullptr, 1, &commandBuffers[job]);
+        engine->submit(submitInfo, fence);
+        (void)device.waitForFences(fence, VK_TRUE, UINT64_MAX);
+        device.resetFences(fence);
+    };
+
+    {
+        vtpl::GpuReactor reactor(*engine);
+
+        std::vector<std::chrono::nanoseconds> blockingTimes;
+        std::vector<std::chrono::nanoseconds> reactorTimes;
+        for (uint32_t i = 0; i < rounds * jobCount; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            fill(0);
+            blockingTimes.push_back(std::chrono::steady_clock::now() - start);
+
+            start = std::chrono::steady_clock::now();
+            vtpl::sync_wait(submit_once(reactor, commandBuffers[0]));
+            reactorTimes.push_back(std::chrono::steady_clock::now() - start);
+        }
+        vtpl::bench::report("latency, blocking submit", blockingTimes);
+        vtpl::bench::report("latency, GpuReactor", reactorTimes);
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t round = 0; round < rounds; round++)
+        {
+            for (uint32_t job = 0; job < jobCount; job++)
+            {
+                fill(job);
+            }
+        }
+        report_throughput("throughput, blocking submit", rounds * jobCount, std::chrono::steady_clock::now() - start);
+
+        start = std::chrono::steady_clock::now();
+        for (uint32_t round = 0; round < rounds; round++)
+        {
+            std::atomic<uint32_t> remaining{jobCount};
+            std::binary_semaphore done{0};
+            for (uint32_t job = 0; job < jobCount; job++)
+            {
+                vtpl::spawn(submit_counted(reactor, commandBuffers[job], remaining, done));
+            }
+            done.acquire();
+        }
+        report_throughput("throughput, GpuReactor", rounds * jobCount, std::chrono::steady_clock::now() - start);
+    }
+
+    device.destroyFence(fence);
+    device.destroyCommandPool(commandPool);
+    vtpl::destroy_buffer(*engine, target);
+    return 0;
+}
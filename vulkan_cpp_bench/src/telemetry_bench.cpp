@@ -0,0 +1,82 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "telemetry.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t streamCount = 64;
+
+/**
+    Run a call on a number of threads at once and print its mean cost per call.
+*/
+void run(const std::string& name, uint32_t threadCount, uint64_t calls,
+         const std::function<void(uint32_t thread, uint64_t call)>& call)
+{
+    std::vector<std::thread> threads;
+    const auto               start = std::chrono::steady_clock::now();
+    for (uint32_t thread = 0; thread < threadCount; thread++)
+    {
+        threads.emplace_back(
+            [&, thread]()
+            {
+                for (uint64_t i = 0; i < calls; i++)
+                {
+                    call(thread, i);
+                }
+            });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    const std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+    // every thread ran its calls in the elapsed time, so this is the cost seen by one caller
+    std::cout << name << ", " << threadCount << " thread(s): "
+              << static_cast<double>(elapsed.count()) / static_cast<double>(calls) << " ns per call" << std::endl;
+}
+} // namespace
+
+/*
+ * Measures what the telemetry costs its callers: Telemetry::record() on the same stream as
+ * the previous call and on a different one, a StageTimer as the library uses it, which adds
+ * two clock reads, count_dropped() and set_queue_depth(), from one thread and from several
+ * threads at once. record() is meant to stay below 100 ns.
+ *
+ * usage: vulkan_telemetry_bench [calls per thread]
+ */
+int main(int argc, char const* argv[])
+{
+    const uint64_t calls = argc > 1 ? static_cast<uint64_t>(std::max(1, std::atoi(argv[1]))) : 10000000;
+    const uint32_t maxThreads = std::max(2U, std::min(8U, std::thread::hardware_concurrency()));
+
+    vtpl::Telemetry& telemetry = vtpl::Telemetry::instance();
+    for (uint32_t threadCount : {1U, maxThreads})
+    {
+        run("record, same stream", threadCount, calls,
+            [&](uint32_t thread, uint64_t i)
+            { telemetry.record(thread, vtpl::Stage::Composite, std::chrono::nanoseconds(1000 + (i & 1023))); });
+        run("record, stream changes every call", threadCount, calls,
+            [&](uint32_t, uint64_t i)
+            {
+                telemetry.record(static_cast<uint32_t>(i % streamCount), vtpl::Stage::Upload,
+                                 std::chrono::nanoseconds(1000 + (i & 1023)));
+            });
+        run("StageTimer, same stream", threadCount, calls,
+            [&](uint32_t thread, uint64_t) { vtpl::StageTimer timer(thread, vtpl::Stage::Upload); });
+        run("count_dropped", threadCount, calls, [&](uint32_t thread, uint64_t) { telemetry.count_dropped(thread); });
+        run("set_queue_depth, shared stream", threadCount, calls,
+            [&](uint32_t, uint64_t i) { telemetry.set_queue_depth(vtpl::Telemetry::allStreams, i & 63); });
+    }
+    return 0;
+}
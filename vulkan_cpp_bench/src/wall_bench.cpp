@@ -0,0 +1,90 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "bench_stats.h"
+#include "engine.h"
+#include "wall_compositor.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t wallWidth = 3840;
+constexpr uint32_t wallHeight = 2160;
+
+/**
+    Composite a square grid of tiles, one stream per tile, with a share of the streams
+    delivering a new frame before every composite.
+*/
+void run(Engine& engine, uint32_t tileCount, uint32_t changedPercent, vk::Extent2D streamExtent, uint32_t frames)
+{
+    const uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(tileCount))));
+    const uint32_t rows = (tileCount + columns - 1) / columns;
+    const float    tileWidth = static_cast<float>(wallWidth) / columns;
+    const float    tileHeight = static_cast<float>(wallHeight) / rows;
+
+    vtpl::WallCompositor        wall(engine, wallWidth, wallHeight, tileCount, streamExtent);
+    std::vector<vtpl::WallTile> tiles;
+    for (uint32_t tile = 0; tile < tileCount; tile++)
+    {
+        tiles.push_back({{(tile % columns) * tileWidth, (tile / columns) * tileHeight, tileWidth, tileHeight}, tile});
+    }
+    wall.set_layout(tiles);
+
+    std::vector<uint8_t> frame(static_cast<size_t>(streamExtent.width) * streamExtent.height * 4);
+    const uint32_t       changed = std::max(1U, tileCount * changedPercent / 100);
+
+    std::vector<std::chrono::nanoseconds> updateTimes;
+    std::vector<std::chrono::nanoseconds> compositeTimes;
+    uint32_t                              next = 0;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t n = 0; n < changed; n++)
+        {
+            frame[0] = static_cast<uint8_t>(i);
+            wall.update_stream(next, frame.data());
+            next = (next + 1) % tileCount;
+        }
+        const auto updated = std::chrono::steady_clock::now();
+        wall.composite();
+        const auto composited = std::chrono::steady_clock::now();
+        updateTimes.push_back(updated - start);
+        compositeTimes.push_back(composited - updated);
+    }
+
+    const std::string name = std::to_string(tileCount) + " tiles, " + std::to_string(changed) + " changed";
+    vtpl::bench::report(name + ", update_stream", updateTimes);
+    vtpl::bench::report(name + ", composite", compositeTimes);
+}
+} // namespace
+
+/*
+ * Times update_stream and composite of a 4K wall with 64 and 256 tiles, with every stream
+ * and with a quarter of the streams changing per frame.
+ *
+ * usage: vulkan_wall_bench [frames] [stream width] [stream height]
+ */
+int main(int argc, char const* argv[])
+{
+    const uint32_t     frames = argc > 1 ? static_cast<uint32_t>(std::max(1, std::atoi(argv[1]))) : 200;
+    const vk::Extent2D streamExtent(argc > 3 ? static_cast<uint32_t>(std::max(1, std::atoi(argv[2]))) : 640,
+                                    argc > 3 ? static_cast<uint32_t>(std::max(1, std::atoi(argv[3]))) : 360);
+
+    std::unique_ptr<Engine> const engine(new Engine());
+    for (uint32_t tileCount : {64U, 256U})
+    {
+        for (uint32_t changedPercent : {100U, 25U})
+        {
+            run(*engine, tileCount, changedPercent, streamExtent, frames);
+        }
+    }
+    return 0;
+}
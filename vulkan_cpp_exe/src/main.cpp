@@ -3,10 +3,16 @@
 // *****************************************************
 
 #include "engine.h"
+#include "telemetry.h"
 #include <memory>
 
 int main(int /*argc*/, char const* /*argv*/[])
 {
     std::unique_ptr<Engine> const engine(new Engine());
+    // the engine has set up the CoreContext session, telemetry.jsonl goes into its folder
+    vtpl::Telemetry::instance().start_export();
+
+    // writes a last line covering everything since the previous one
+    vtpl::Telemetry::instance().stop_export();
     return 0;
 }
@@ -21,6 +21,8 @@ class CoreContext
     static CoreContext& instance(std::string session_folder = "session/", std::string lib_folder = "lib/");
     CoreContext(const CoreContext&) = delete;
     CoreContext& operator=(const CoreContext&) = delete;
+
+    const std::string& get_session_folder() const { return _session_folder; }
 };
 
 } // namespace vtpl
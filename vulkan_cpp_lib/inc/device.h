@@ -7,6 +7,7 @@
 #define device_h
 #include "vulkan_logging.h"
 #include <logging.h>
+#include <optional>
 #include <set>
 #include <sstream>
 #include <vector>
@@ -219,6 +220,111 @@ vk::PhysicalDevice choose_physical_device(const vk::Instance& instance, const bo
 
     return nullptr;
 }
+
+/**
+    Find a queue family which can run both graphics and compute work.
+
+    \param device the physical device to query
+    \param debug whether the system is running in debug mode
+    \returns the index of the queue family, or nothing if the device has none
+*/
+std::optional<uint32_t> find_queue_family(const vk::PhysicalDevice& device, const bool debug)
+{
+    std::vector<vk::QueueFamilyProperties> queueFamilies = device.getQueueFamilyProperties();
+
+    if (debug)
+    {
+        RAY_LOG_INF << "There are " << queueFamilies.size() << " queue families available on the system.";
+    }
+
+    for (uint32_t i = 0; i < static_cast<uint32_t>(queueFamilies.size()); i++)
+    {
+        /*
+         * Overlay, compositing and analytics passes record compute and draw work into
+         * the same command buffer, so a single family supporting both is required.
+         */
+        const vk::QueueFlags required = vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute;
+        if ((queueFamilies[i].queueFlags & required) == required)
+        {
+            if (debug)
+            {
+                RAY_LOG_INF << "Queue Family " << i << " is suitable for graphics and compute";
+            }
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+/**
+    Check whether the physical device reports per heap budgets through VK_EXT_memory_budget.
+    Without it, resource caches can only budget against the total heap sizes.
+
+    \param device the physical device to check
+    \param debug whether the system is running in debug mode
+    \returns whether the extension is available
+*/
+bool supports_memory_budget(const vk::PhysicalDevice& device, const bool debug)
+{
+    const bool supported = checkDeviceExtensionSupport(device, {VK_EXT_MEMORY_BUDGET_EXTENSION_NAME}, false);
+    if (debug)
+    {
+        RAY_LOG_INF << "Memory budget extension is " << (supported ? "available" : "not available");
+    }
+    return supported;
+}
+
+/**
+    Create a logical device with a single queue from the given family.
+
+    \param physicalDevice the physical device to wrap
+    \param queueFamilyIndex the queue family to create the queue from
+    \param extensions the device extensions to enable, all must be supported
+    \param debug whether the system is running in debug mode
+    \returns the created device, or nullptr on failure
+*/
+vk::Device make_logical_device(const vk::PhysicalDevice& physicalDevice, uint32_t queueFamilyIndex,
+                               const std::vector<const char*>& extensions, const bool debug)
+{
+    if (debug)
+    {
+        RAY_LOG_INF << "Making a logical device";
+    }
+
+    float                     queuePriority = 1.0f;
+    vk::DeviceQueueCreateInfo queueCreateInfo =
+        vk::DeviceQueueCreateInfo(vk::DeviceQueueCreateFlags(), queueFamilyIndex, 1, &queuePriority);
+
+    vk::PhysicalDeviceFeatures deviceFeatures = vk::PhysicalDeviceFeatures();
+
+    std::vector<const char*> enabledLayers;
+    if (debug)
+    {
+        enabledLayers.push_back("VK_LAYER_KHRONOS_validation");
+    }
+
+    vk::DeviceCreateInfo deviceInfo = vk::DeviceCreateInfo(
+        vk::DeviceCreateFlags(), 1, &queueCreateInfo, static_cast<uint32_t>(enabledLayers.size()),
+        enabledLayers.data(), static_cast<uint32_t>(extensions.size()), extensions.data(), &deviceFeatures);
+
+    try
+    {
+        vk::Device device = physicalDevice.createDevice(deviceInfo);
+        if (debug)
+        {
+            RAY_LOG_INF << "GPU has been successfully abstracted!";
+        }
+        return device;
+    }
+    catch (vk::SystemError err)
+    {
+        if (debug)
+        {
+            RAY_LOG_ERR << "Device creation failed!";
+        }
+        return nullptr;
+    }
+}
 } // namespace vtpl
 
 #endif // device_h
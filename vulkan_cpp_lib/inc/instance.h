@@ -5,6 +5,7 @@
 #pragma once
 #ifndef instance_h
 #define instance_h
+#include <cstring>
 #include <logging.h>
 #include <sstream>
 #include <string>
@@ -104,14 +105,34 @@ bool supported(std::vector<const char*>& extensions, std::vector<const char*>& l
     return true;
 }
 
+/**
+    Check whether the Vulkan loader offers an instance extension.
+
+    \param extension the name of the extension
+    \returns whether the extension can be enabled
+*/
+bool instance_extension_available(const char* extension)
+{
+    for (vk::ExtensionProperties supportedExtension : vk::enumerateInstanceExtensionProperties())
+    {
+        if (strcmp(extension, supportedExtension.extensionName) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 /**
         Create a Vulkan instance.
 
         \param debug whether the system is being run in debug mode.
         \param applicationName the name of the application.
+        \param requestedExtensions extensions to enable on top of the debug ones, such as the
+        surface extensions of the windowing system.
         \returns the instance created.
 */
-vk::Instance make_instance(bool debug, const char* applicationName)
+vk::Instance make_instance(bool debug, const char* applicationName, const std::vector<const char*>& requestedExtensions)
 {
 
     if (debug)
@@ -160,8 +181,11 @@ vk::Instance make_instance(bool debug, const char* applicationName)
     /*
      * Or drop down to an earlier version to ensure compatibility with more devices
      * VK_MAKE_API_VERSION(variant, major, minor, patch)
+     *
+     * 1.1 is the lowest we can go: the analytics kernels rely on subgroup properties
+     * being queryable through vkGetPhysicalDeviceProperties2.
      */
-    version = VK_MAKE_API_VERSION(0, 1, 0, 0);
+    version = VK_MAKE_API_VERSION(0, 1, 1, 0);
 
     /*
     * from vulkan_structs.hpp:
@@ -177,14 +201,10 @@ vk::Instance make_instance(bool debug, const char* applicationName)
         vk::ApplicationInfo(applicationName, version, "Doing it the hard way", version, version);
 
     /*
-     * Everything with Vulkan is "opt-in", so we need to query which extensions glfw needs
-     * in order to interface with vulkan.
+     * Everything with Vulkan is "opt-in", so the caller passes in the extensions glfw (or
+     * the headless surface) needs in order to interface with vulkan.
      */
-    uint32_t     glfwExtensionCount = 0;
-    const char** glfwExtensions = nullptr;
-    // glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount); // FIXME
-
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    std::vector<const char*> extensions(requestedExtensions.begin(), requestedExtensions.end());
 
     // In order to hook in a custom validation callback
     if (debug)
@@ -0,0 +1,60 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef pipeline_h
+#define pipeline_h
+#include <string>
+#include <vulkan/vulkan.hpp>
+
+namespace vtpl
+{
+/**
+    Create a compute pipeline from a compiled shader in the shader folder.
+
+    \param device the logical device to create the pipeline on
+    \param layout the pipeline layout
+    \param shaderFile the name of the compiled compute shader
+    \param debug whether the system is running in debug mode
+    \param specialization optional specialization constants for the shader
+    \returns the created pipeline
+*/
+vk::Pipeline make_compute_pipeline(const vk::Device& device, const vk::PipelineLayout& layout,
+                                   const std::string& shaderFile, bool debug,
+                                   const vk::SpecializationInfo* specialization = nullptr);
+
+/**
+    Create a graphics pipeline which draws triangle lists without vertex buffers into the
+    first subpass of a render pass, with alpha blending and dynamic viewport and scissor.
+
+    \param device the logical device to create the pipeline on
+    \param layout the pipeline layout
+    \param renderPass the render pass the pipeline is used in
+    \param vertexShaderFile the name of the compiled vertex shader
+    \param fragmentShaderFile the name of the compiled fragment shader
+    \param debug whether the system is running in debug mode
+    \param specialization optional specialization constants for both shader stages
+    \returns the created pipeline
+*/
+vk::Pipeline make_graphics_pipeline(const vk::Device& device, const vk::PipelineLayout& layout,
+                                    const vk::RenderPass& renderPass, const std::string& vertexShaderFile,
+                                    const std::string& fragmentShaderFile, bool debug,
+                                    const vk::SpecializationInfo* specialization = nullptr);
+
+/**
+    Create a render pass with a single color attachment which is left ready to be copied from
+    or sampled afterwards.
+
+    \param device the logical device to create the render pass on
+    \param format the format of the color attachment
+    \param finalLayout the layout the attachment is left in
+    \param loadOp whether to clear the attachment or keep the previous frame, in which case it
+    must already be in finalLayout when the render pass begins
+    \returns the created render pass
+*/
+vk::RenderPass make_color_render_pass(const vk::Device& device, vk::Format format, vk::ImageLayout finalLayout,
+                                      vk::AttachmentLoadOp loadOp = vk::AttachmentLoadOp::eClear);
+} // namespace vtpl
+
+#endif // pipeline_h
@@ -0,0 +1,34 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef shader_h
+#define shader_h
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vtpl
+{
+/**
+    Read a compiled SPIR-V file from the shader folder.
+
+    \param filename the name of the .spv file, relative to the shader folder
+    \param debug whether the system is running in debug mode
+    \returns the contents of the file as 32 bit words
+*/
+std::vector<uint32_t> read_shader_file(const std::string& filename, bool debug);
+
+/**
+    Create a shader module from a compiled SPIR-V file in the shader folder.
+
+    \param device the logical device to create the module on
+    \param filename the name of the .spv file, relative to the shader folder
+    \param debug whether the system is running in debug mode
+    \returns the created shader module
+*/
+vk::ShaderModule make_shader_module(const vk::Device& device, const std::string& filename, bool debug);
+} // namespace vtpl
+
+#endif // shader_h
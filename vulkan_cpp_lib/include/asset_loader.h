@@ -0,0 +1,139 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef asset_loader_h
+#define asset_loader_h
+#include "engine.h"
+#include "gpu_memory.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vtpl
+{
+/**
+    Where an asset is in its way from disk to the GPU.
+*/
+enum class AssetState
+{
+    Decoding,
+    Decoded,
+    Ready,
+    Failed
+};
+
+/**
+    Loads image files into sampled textures without blocking the caller.
+
+    load() hands back a handle at once, and texture() gives a shared placeholder until the
+    real texture is in. Files are decoded on a pool of worker threads; update() then streams
+    the decoded images through one staging buffer and one submission, which also generates
+    their mip chains with blits, and a later update() swaps them in once the GPU is done with
+    it. Nothing waits for the GPU. Call it once per frame from the thread that renders.
+*/
+class AssetLoader
+{
+  public:
+    using Handle = uint32_t;
+
+    /**
+        \param engine the engine owning the device, must outlive the loader
+        \param threadCount the number of decoding threads, zero picks one per hardware thread
+        \param format the texture format, sRGB for colour images and UNORM for data
+    */
+    explicit AssetLoader(Engine& engine, size_t threadCount = 0, vk::Format format = vk::Format::eR8G8B8A8Srgb);
+    ~AssetLoader();
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    /**
+        Queue an image file for loading. Any format stb_image reads is accepted, and the
+        image is expanded to RGBA.
+
+        \param path the file to load
+        \returns the handle to ask for the texture with
+    */
+    Handle load(const std::string& path);
+
+    /**
+        Swap in the textures of the previous upload if the GPU has finished it, and start
+        uploading decoded images if no upload is in flight. Assets whose upload cannot be
+        set up or submitted fail.
+
+        \param maxBytes the most texel bytes to stream in this call, at least one image is
+        always taken so large images cannot stall
+        \returns the number of textures which became ready
+    */
+    size_t update(vk::DeviceSize maxBytes = 64ULL << 20);
+
+    /**
+        \returns the texture of the asset, or the placeholder while it is not ready or failed
+    */
+    Image texture(Handle handle) const;
+
+    /**
+        \returns how far the asset has got
+    */
+    AssetState state(Handle handle) const;
+
+    /**
+        \returns the number of assets still decoding or waiting for update()
+    */
+    size_t pending() const;
+
+  private:
+    // upload submitted by one update() and finished by a later one
+    struct Upload
+    {
+        std::vector<Handle> batch;
+        std::vector<Image>  images;
+        Buffer              staging;
+    };
+
+    struct Asset
+    {
+        std::string                    path;
+        AssetState                     state{AssetState::Decoding};
+        vk::Extent2D                   extent{0, 0};
+        std::shared_ptr<const uint8_t> pixels;
+        Image                          image;
+    };
+
+    Engine&    engine;
+    vk::Format format;
+    bool       blitMipmaps;
+    Image      placeholder;
+
+    mutable std::mutex      mutex;
+    std::condition_variable wakeup;
+    // deque so workers can hold on to an asset while new ones are added
+    std::deque<Asset>        assets;
+    std::deque<Handle>       queued;
+    std::vector<Handle>      decoded;
+    bool                     stopping{false};
+    std::vector<std::thread> workers;
+
+    // only touched by update() and the destructor
+    vk::CommandPool       commandPool{nullptr};
+    vk::CommandBuffer     commandBuffer{nullptr};
+    vk::Fence             fence{nullptr};
+    std::optional<Upload> inFlight;
+
+    void   make_placeholder();
+    void   start_upload(vk::DeviceSize maxBytes);
+    size_t finish_upload(bool wait);
+    void   decode(Handle handle, const std::string& path);
+    void   run();
+};
+} // namespace vtpl
+
+#endif // asset_loader_h
@@ -0,0 +1,267 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef command_trace_h
+#define command_trace_h
+#include "gpu_memory.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vtpl
+{
+/**
+    Operations stored in a command trace.
+*/
+enum class TraceOp : uint8_t
+{
+    CreateBuffer = 1,
+    CreateImage,
+    Destroy,
+    Upload,
+    Dispatch,
+    Submit,
+    Frame,
+    CopyToImage,
+    Draw
+};
+
+/**
+    One decoded trace record. Only the fields of its operation are set.
+*/
+struct TraceRecord
+{
+    TraceOp op{TraceOp::Frame};
+    // resource the operation applies to, ids start at 1
+    uint32_t id{0};
+
+    // CreateBuffer
+    uint64_t size{0};
+    uint32_t usage{0};
+    uint32_t properties{0};
+
+    // CreateImage, usage is shared with CreateBuffer; Draw, the extent and format of its target
+    vk::Extent2D extent{0, 0};
+    vk::Format   format{vk::Format::eUndefined};
+    uint32_t     mipLevels{1};
+    uint32_t     arrayLayers{1};
+
+    // Upload, size is shared with CreateBuffer; data is only kept for small payloads
+    uint64_t             offset{0};
+    uint64_t             hash{0};
+    std::vector<uint8_t> data;
+
+    // Dispatch and Draw, binding i of the shader is the buffer with id bindings[i]; the
+    // shader of a Draw is its vertex shader
+    std::string             shader;
+    std::vector<uint32_t>   bindings;
+    std::vector<uint8_t>    pushConstants;
+    std::array<uint32_t, 3> groups{0, 0, 0};
+
+    // Submit
+    uint32_t commandBufferCount{0};
+
+    // CopyToImage, from the buffer id into the image target
+    uint32_t                         target{0};
+    std::vector<vk::BufferImageCopy> regions;
+
+    // Draw into the image target, sampling the image sampled at the binding after the buffers
+    std::string fragmentShader;
+    uint32_t    sampled{0};
+    uint32_t    vertexCount{0};
+    uint32_t    instanceCount{0};
+
+    // Frame, time since the trace was started
+    std::chrono::nanoseconds time{0};
+};
+
+/**
+    \returns a 64 bit hash of a payload, fast enough to run on every uploaded video frame
+*/
+uint64_t payload_hash(const void* data, size_t size);
+
+/**
+    Compact binary recording of what the engine was asked to do: resources created and
+    destroyed, host uploads, copies into images, compute dispatches, draws, queue submissions
+    and frame boundaries.
+
+    Resources are identified by small ids instead of their handles, so a trace can be
+    replayed on another device. Upload payloads are not stored, only their size and
+    optionally their hash, except for small ones such as flags and indirect arguments and
+    those the caller marks, such as draw lists, which steer the GPU work and are kept
+    verbatim.
+
+    Copies, dispatches and draws are kept per command buffer while it is recorded and
+    written with each submission of that buffer, so work recorded on one thread and
+    submitted on another lands at its submission, and a command buffer submitted again
+    replays its commands again. Other records are appended in the order the calls reach the
+    trace.
+
+    Recording is enabled with Engine::set_trace, before the renderers whose work should be
+    captured are created. Operations on resources created earlier are left out.
+*/
+class CommandTrace
+{
+  public:
+    // version 2 added copies into images and draws, version 1 traces are still read
+    static constexpr uint32_t version = 2;
+    // uploads up to this size are stored with their payload
+    static constexpr uint64_t inlineLimit = 4096;
+
+    /**
+        \param path the file to write, truncated if it exists
+        \param hashPayloads whether to store a hash of every upload payload
+    */
+    explicit CommandTrace(const std::string& path, bool hashPayloads = true);
+    ~CommandTrace();
+    CommandTrace(const CommandTrace&) = delete;
+    CommandTrace& operator=(const CommandTrace&) = delete;
+
+    void create_buffer(vk::Buffer buffer, vk::DeviceSize size, vk::BufferUsageFlags usage,
+                       vk::MemoryPropertyFlags properties);
+    void create_image(const Image& image, vk::ImageUsageFlags usage);
+    void destroy(vk::Buffer buffer);
+    void destroy(vk::Image image);
+
+    /**
+        Record a write of the host into a buffer, or a transfer into it.
+
+        \param store whether to keep the payload whatever its size, for data which steers the
+        GPU work and would make the replay do something else when replaced by filler
+    */
+    void upload(vk::Buffer buffer, vk::DeviceSize offset, const void* data, vk::DeviceSize size,
+                bool store = false);
+
+    /**
+        Record an upload of the base level of an image.
+    */
+    void upload(vk::Image image, const void* data, vk::DeviceSize size);
+
+    /**
+        Record a compute dispatch.
+
+        \param commandBuffer the command buffer the dispatch is recorded into
+        \param shader the name of the compiled compute shader
+        \param bindings the storage buffers bound to bindings 0, 1, ... of set 0
+        \param pushConstants the push constant bytes, from offset 0
+        \param pushSize the number of push constant bytes
+        \param x, y, z the number of workgroups
+    */
+    void dispatch(vk::CommandBuffer commandBuffer, const std::string& shader, vk::ArrayProxy<const vk::Buffer> bindings,
+                  const void* pushConstants, uint32_t pushSize, uint32_t x, uint32_t y, uint32_t z);
+
+    /**
+        Start tracing the commands of a command buffer, dropping those traced for it before.
+        Called wherever a command buffer which may carry traced commands is begun.
+    */
+    void begin(vk::CommandBuffer commandBuffer);
+
+    /**
+        Record a copy from a buffer into an image.
+
+        \param commandBuffer the command buffer the copy is recorded into
+    */
+    void copy(vk::CommandBuffer commandBuffer, vk::Buffer buffer, vk::Image image,
+              vk::ArrayProxy<const vk::BufferImageCopy> regions);
+
+    /**
+        Record a render pass which loads an image and draws instanced triangles into it,
+        without vertex buffers, like the wall compositor does.
+
+        \param commandBuffer the command buffer the render pass is recorded into
+        \param vertexShader, fragmentShader the names of the compiled shaders
+        \param target the image drawn into
+        \param bindings the storage buffers bound to bindings 0, 1, ... of set 0
+        \param sampled the image sampled at the binding after the storage buffers
+        \param pushConstants the push constant bytes, from offset 0
+        \param pushSize the number of push constant bytes
+        \param vertexCount, instanceCount the size of the draw, no draw when instanceCount is 0
+    */
+    void draw(vk::CommandBuffer commandBuffer, const std::string& vertexShader, const std::string& fragmentShader,
+              const Image& target, vk::ArrayProxy<const vk::Buffer> bindings, vk::Image sampled,
+              const void* pushConstants, uint32_t pushSize, uint32_t vertexCount, uint32_t instanceCount);
+
+    /**
+        Record a queue submission, preceded by the commands traced for each of its command
+        buffers. Called by Engine::submit.
+    */
+    void submit(vk::ArrayProxy<const vk::SubmitInfo> submitInfos);
+
+    /**
+        Record the end of a frame.
+    */
+    void frame();
+
+  private:
+    std::mutex                             mutex;
+    std::ofstream                          out;
+    bool                                   hashPayloads;
+    std::chrono::steady_clock::time_point  start{std::chrono::steady_clock::now()};
+
+    // buffer and image handles may coincide, so each has its own ids
+    std::unordered_map<uint64_t, uint32_t> bufferIds;
+    std::unordered_map<uint64_t, uint32_t> imageIds;
+    uint32_t                               nextId{1};
+    // encoded commands of every command buffer since it was last begun
+    std::unordered_map<uint64_t, std::string> recorded;
+
+    std::string& commands(vk::CommandBuffer commandBuffer);
+    void write_destroy(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t handle);
+    void write_upload(uint32_t id, uint64_t offset, const void* data, uint64_t size, uint64_t hash, bool store);
+    void write_bindings(std::string& bytes, vk::ArrayProxy<const vk::Buffer> bindings);
+    template <typename T> void put(T value) { out.write(reinterpret_cast<const char*>(&value), sizeof(value)); }
+    template <typename T> static void append(std::string& bytes, T value)
+    {
+        bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    static void append(std::string& bytes, const void* data, size_t size);
+    static void append_string(std::string& bytes, const std::string& value);
+};
+
+/**
+    Reads the records of a trace written by CommandTrace.
+*/
+class TraceReader
+{
+  public:
+    /**
+        \param path the trace file, throws std::runtime_error when it is not a trace of a
+        supported version
+    */
+    explicit TraceReader(const std::string& path);
+
+    /**
+        Read the next record.
+
+        \returns false at the end of the trace, throws std::runtime_error when it is cut short
+        or a record claims more data than the file holds
+    */
+    bool next(TraceRecord& record);
+
+  private:
+    std::ifstream in;
+    uint64_t      fileSize{0};
+
+    std::string read_string();
+    void        read_bindings(std::vector<uint32_t>& bindings);
+    // throws unless count items of itemSize bytes fit into the rest of the file
+    void        check_remaining(uint64_t count, uint64_t itemSize);
+
+    template <typename T> T get()
+    {
+        T value{};
+        in.read(reinterpret_cast<char*>(&value), sizeof(value));
+        return value;
+    }
+};
+} // namespace vtpl
+
+#endif // command_trace_h
@@ -5,13 +5,79 @@
 #pragma once
 #ifndef engine_h
 #define engine_h
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <vulkan/vulkan.hpp>
+
+namespace vtpl
+{
+class CommandTrace;
+}
+
 class Engine
 {
 
   public:
-    Engine();
+    /**
+        \param windowExtensions instance extensions the windowing system needs to create its
+        surfaces, e.g. from glfwGetRequiredInstanceExtensions. Headless surfaces are enabled
+        whenever the loader offers them.
+    */
+    explicit Engine(const std::vector<const char*>& windowExtensions = {});
     ~Engine();
+    Engine(const Engine&) = delete;
+    Engine& operator=(const Engine&) = delete;
+
+    bool                             is_debug() const { return debugMode; }
+    const vk::Instance&              get_instance() const { return instance; }
+    const vk::DispatchLoaderDynamic& get_dispatch() const { return dldi; }
+    bool                             has_headless_surface() const { return headlessSurfaceSupported; }
+    const vk::PhysicalDevice&        get_physical_device() const { return physicalDevice; }
+    const vk::Device&                get_device() const { return device; }
+    const vk::Queue&                 get_queue() const { return queue; }
+    uint32_t                         get_queue_family_index() const { return queueFamilyIndex; }
+    const vk::CommandPool&           get_command_pool() const { return commandPool; }
+    bool                             has_memory_budget() const { return memoryBudgetSupported; }
+
+    /**
+        Submit work to the engine queue. The queue requires external synchronization, so
+        every submission from the library goes through here.
+
+        \param submitInfos the work to submit, one or more batches in a single call
+        \param fence fence to signal when all of the work has finished, may be nullptr
+    */
+    void submit(vk::ArrayProxy<const vk::SubmitInfo> submitInfos, vk::Fence fence);
+
+    /**
+        Record a one-off command buffer, submit it and wait for it to finish.
+
+        \param record callback which records commands into the command buffer
+    */
+    void immediate_submit(const std::function<void(vk::CommandBuffer)>& record);
+
+    /**
+        Queue presentation of swapchain images, serialized with submit.
+
+        \param presentInfo the images to present
+        \returns success or suboptimal, throws vk::OutOfDateKHRError when the swapchain no
+        longer matches its surface
+    */
+    vk::Result present(const vk::PresentInfoKHR& presentInfo);
+
+    /**
+        Start recording resources, uploads, copies, dispatches, draws and submissions into a
+        trace, or stop with nullptr. Every recording call holds a reference of its own, so the
+        trace is closed once the caller released it and the last of them has returned.
+    */
+    void set_trace(std::shared_ptr<vtpl::CommandTrace> commandTrace) { trace.store(std::move(commandTrace)); }
+
+    /**
+        \returns the trace being recorded into, or nullptr when not recording
+    */
+    std::shared_ptr<vtpl::CommandTrace> get_trace() const { return trace.load(); }
 
   private:
     // whether to print debug messages in functions
@@ -26,17 +92,34 @@ class Engine
     vk::Instance               instance{nullptr};
     vk::DebugUtilsMessengerEXT debugMessenger{nullptr};
     vk::DispatchLoaderDynamic  dldi;
+    bool                       headlessSurfaceSupported{false};
 
     // device-related variables
     vk::PhysicalDevice physicalDevice{nullptr};
+    vk::Device         device{nullptr};
+    vk::Queue          queue{nullptr};
+    uint32_t           queueFamilyIndex{0};
+    std::mutex         queueMutex;
+    bool               memoryBudgetSupported{false};
+
+    // command-related variables, the pool is only used under immediateMutex and renderers
+    // which record from their own threads own their pools
+    vk::CommandPool commandPool{nullptr};
+    vk::Fence       immediateFence{nullptr};
+    std::mutex      immediateMutex;
+
+    std::atomic<std::shared_ptr<vtpl::CommandTrace>> trace;
 
     // glfw setup
     void build_glfw_window();
 
     // instance setup
-    void make_instance();
+    void make_instance(const std::vector<const char*>& windowExtensions);
 
     // device setup
     void make_device();
+
+    // command setup
+    void make_command_pool();
 };
 #endif // engine_h
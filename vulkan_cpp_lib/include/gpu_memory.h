@@ -0,0 +1,171 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef gpu_memory_h
+#define gpu_memory_h
+#include <cstdint>
+#include <vulkan/vulkan.hpp>
+
+class Engine;
+
+namespace vtpl
+{
+/**
+    A buffer together with its backing allocation. Host visible buffers stay mapped for
+    their whole lifetime, and mapped is nullptr for device local ones.
+*/
+struct Buffer
+{
+    vk::Buffer       buffer{nullptr};
+    vk::DeviceMemory memory{nullptr};
+    vk::DeviceSize   size{0};
+    void*            mapped{nullptr};
+};
+
+/**
+    A 2D image together with its backing allocation and a view over all of its mip levels
+    and array layers.
+*/
+struct Image
+{
+    vk::Image        image{nullptr};
+    vk::DeviceMemory memory{nullptr};
+    vk::ImageView    view{nullptr};
+    vk::Format       format{vk::Format::eUndefined};
+    vk::Extent2D     extent{0, 0};
+    uint32_t         mipLevels{1};
+    uint32_t         arrayLayers{1};
+};
+
+/**
+    Find a memory type which is allowed by the filter and has all requested properties.
+
+    \param physicalDevice the physical device to query
+    \param typeFilter bitmask of allowed memory types, from vk::MemoryRequirements
+    \param properties the properties the memory type must have
+    \returns the index of the memory type, throws std::runtime_error if there is none
+*/
+uint32_t find_memory_type(const vk::PhysicalDevice& physicalDevice, uint32_t typeFilter,
+                          vk::MemoryPropertyFlags properties);
+
+/**
+    Create a buffer and bind freshly allocated memory to it.
+
+    \param engine the engine owning the device
+    \param size the size of the buffer in bytes
+    \param usage how the buffer will be used
+    \param properties the memory properties of the allocation
+    \returns the created buffer, mapped if the memory is host visible
+*/
+Buffer make_buffer(const Engine& engine, vk::DeviceSize size, vk::BufferUsageFlags usage,
+                   vk::MemoryPropertyFlags properties);
+
+/**
+    Destroy a buffer created by make_buffer and release its memory.
+*/
+void destroy_buffer(const Engine& engine, Buffer& buffer);
+
+/**
+    Query the memory a buffer made by make_buffer would need, without allocating any.
+
+    \param engine the engine owning the device
+    \param size the size of the buffer in bytes
+    \param usage how the buffer will be used
+    \returns the size, alignment and allowed memory types of the allocation
+*/
+vk::MemoryRequirements buffer_requirements(const Engine& engine, vk::DeviceSize size, vk::BufferUsageFlags usage);
+
+/**
+    Query the memory an image made by make_image or make_image_array would need, without
+    allocating any.
+
+    \param engine the engine owning the device
+    \param extent the size of the base mip level
+    \param format the texel format
+    \param usage how the image will be used
+    \param mipLevels the number of mip levels
+    \param arrayLayers the number of layers
+    \returns the size, alignment and allowed memory types of the allocation
+*/
+vk::MemoryRequirements image_requirements(const Engine& engine, vk::Extent2D extent, vk::Format format,
+                                          vk::ImageUsageFlags usage, uint32_t mipLevels = 1,
+                                          uint32_t arrayLayers = 1);
+
+/**
+    Create a device local 2D image with a view over all of its mip levels.
+
+    \param engine the engine owning the device
+    \param extent the size of the base mip level
+    \param format the texel format
+    \param usage how the image will be used
+    \param mipLevels the number of mip levels
+    \returns the created image, in undefined layout
+*/
+Image make_image(const Engine& engine, vk::Extent2D extent, vk::Format format, vk::ImageUsageFlags usage,
+                 uint32_t mipLevels = 1);
+
+/**
+    Create a device local 2D array image with a 2D array view over all of its layers.
+
+    \param engine the engine owning the device
+    \param extent the size of every layer
+    \param format the texel format
+    \param usage how the image will be used
+    \param arrayLayers the number of layers
+    \returns the created image, in undefined layout
+*/
+Image make_image_array(const Engine& engine, vk::Extent2D extent, vk::Format format, vk::ImageUsageFlags usage,
+                       uint32_t arrayLayers);
+
+/**
+    Destroy an image created by make_image or make_image_array and release its memory.
+*/
+void destroy_image(const Engine& engine, Image& image);
+
+/**
+    Record a layout transition of all mip levels and layers of a color image.
+
+    \param commandBuffer the command buffer to record into
+    \param image the image to transition
+    \param oldLayout the current layout
+    \param newLayout the requested layout
+*/
+void transition_image(const vk::CommandBuffer& commandBuffer, const Image& image, vk::ImageLayout oldLayout,
+                      vk::ImageLayout newLayout);
+
+/**
+    Record blits which fill every mip level of an image from its base level, halving the
+    size each step. The whole image must be in transfer destination layout with the base
+    level written, and ends up in shader read only layout. The format must support linear
+    blits, see supports_linear_blit.
+
+    \param commandBuffer the command buffer to record into
+    \param image the image to fill, created with transfer source and destination usage
+*/
+void generate_mipmaps(const vk::CommandBuffer& commandBuffer, const Image& image);
+
+/**
+    \returns whether images of the format can be filtered when blitting between mip levels
+*/
+bool supports_linear_blit(const vk::PhysicalDevice& physicalDevice, vk::Format format);
+
+/**
+    \returns the number of mip levels down to 1x1 for the given base size
+*/
+uint32_t mip_level_count(vk::Extent2D extent);
+
+/**
+    Upload tightly packed texels into the base level of an image through a staging buffer,
+    leaving the image in shader read only layout. Blocks until the copy has finished.
+
+    \param engine the engine to submit the copy on
+    \param image the destination image, in undefined layout
+    \param data the texels to upload
+    \param size the number of bytes in data
+*/
+void upload_image(Engine& engine, const Image& image, const void* data, vk::DeviceSize size);
+} // namespace vtpl
+
+#endif // gpu_memory_h
@@ -0,0 +1,157 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef gpu_reactor_h
+#define gpu_reactor_h
+#include "engine.h"
+#include "gpu_memory.h"
+#include "gpu_task.h"
+#include "submission_queue.h"
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vtpl
+{
+/**
+    Decides where a coroutine continues once its GPU work has finished, e.g. by posting the
+    handle to a thread pool. An empty executor resumes on the reactor thread.
+*/
+using Executor = std::function<void(std::coroutine_handle<>)>;
+
+/**
+    Lets coroutines co_await GPU work instead of blocking a thread on a fence.
+
+    Every awaited submission gets a fence from a pool. A single reactor thread waits on the
+    fences of all outstanding work at once and hands each finished coroutine to the executor
+    it was awaited with, so any number of in-flight jobs share one waiting thread. The thread
+    sleeps until work is launched and then blocks on the fences without a timeout.
+*/
+class GpuReactor
+{
+  public:
+    /**
+        Awaitable which submits GPU work when awaited and resumes once it has finished.
+    */
+    class Awaitable
+    {
+      public:
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() const noexcept {}
+
+      private:
+        friend class GpuReactor;
+        Awaitable(GpuReactor& reactor, std::function<void(vk::Fence)> submitWork, std::function<void()> complete,
+                  Executor executor);
+
+        GpuReactor&                    reactor;
+        std::function<void(vk::Fence)> submitWork;
+        std::function<void()>          complete;
+        Executor                       executor;
+    };
+
+    /**
+        Awaitable which copies a buffer range to the host and resumes with the bytes.
+    */
+    class ReadbackAwaitable
+    {
+      public:
+        bool                 await_ready() const noexcept { return false; }
+        void                 await_suspend(std::coroutine_handle<> handle);
+        std::vector<uint8_t> await_resume() { return std::move(data); }
+
+      private:
+        friend class GpuReactor;
+        ReadbackAwaitable(GpuReactor& reactor, const vtpl::Buffer& source, vk::DeviceSize offset, vk::DeviceSize size,
+                          Executor executor);
+
+        GpuReactor&          reactor;
+        vk::Buffer           source;
+        vk::DeviceSize       offset;
+        vk::DeviceSize       size;
+        Executor             executor;
+        std::vector<uint8_t> data;
+    };
+
+    /**
+        \param engine the engine whose queue the work goes to, must outlive the reactor
+        \param submissionQueue when set, work is pushed through it instead of being submitted
+        directly, must outlive the reactor
+    */
+    explicit GpuReactor(Engine& engine, SubmissionQueue* submissionQueue = nullptr);
+    ~GpuReactor();
+    GpuReactor(const GpuReactor&) = delete;
+    GpuReactor& operator=(const GpuReactor&) = delete;
+
+    /**
+        Submit a recorded command buffer. The command buffer must stay alive until the
+        awaiting coroutine resumes.
+    */
+    Awaitable submit(vk::CommandBuffer commandBuffer, Executor executor = {});
+
+    /**
+        Copy bytes into a buffer through a staging buffer. The data is copied before the
+        awaiting coroutine suspends, so it does not need to outlive the call.
+    */
+    Awaitable upload(const vtpl::Buffer& destination, vk::DeviceSize offset, const void* data, vk::DeviceSize size,
+                     Executor executor = {});
+
+    /**
+        Copy a buffer range back to the host.
+    */
+    ReadbackAwaitable readback(const vtpl::Buffer& source, vk::DeviceSize offset, vk::DeviceSize size,
+                               Executor executor = {});
+
+    /**
+        \returns the number of submissions which have not finished yet
+    */
+    size_t in_flight() const { return inFlight.load(std::memory_order_relaxed); }
+
+  private:
+    struct Job
+    {
+        vk::Fence               fence;
+        std::coroutine_handle<> handle;
+        std::function<void()>   complete;
+        Executor                executor;
+    };
+
+    Engine&          engine;
+    SubmissionQueue* submissionQueue;
+
+    // held from submission until the job is queued, so jobs are launched in submission order
+    std::mutex submitMutex;
+
+    // jobs launched since the reactor last looked, and fences ready for reuse
+    std::mutex              mutex;
+    std::condition_variable wakeup;
+    std::vector<Job>        launched;
+    std::vector<vk::Fence>  freeFences;
+    bool                    stopping{false};
+    std::atomic<size_t>     inFlight{0};
+
+    // transfer work recorded by the reactor itself
+    std::mutex      commandMutex;
+    vk::CommandPool commandPool{nullptr};
+
+    std::thread thread;
+
+    void              launch(std::coroutine_handle<> handle, const std::function<void(vk::Fence)>& submitWork,
+                             std::function<void()> complete, Executor executor);
+    vk::CommandBuffer record_transfer(const std::function<void(vk::CommandBuffer)>& record);
+    void              submit_commands(vk::CommandBuffer commandBuffer, vk::Fence fence);
+    void              free_transfer(vk::CommandBuffer commandBuffer);
+    void              run();
+};
+} // namespace vtpl
+
+#endif // gpu_reactor_h
@@ -0,0 +1,199 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef gpu_task_h
+#define gpu_task_h
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <semaphore>
+#include <type_traits>
+#include <utility>
+
+namespace vtpl
+{
+template <typename T = void> class Task;
+
+namespace detail
+{
+struct FinalAwaiter
+{
+    bool await_ready() const noexcept { return false; }
+
+    // hand control straight back to whoever awaited the task
+    template <typename Promise> std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+    {
+        std::coroutine_handle<> continuation = handle.promise().continuation;
+        return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+};
+
+struct PromiseBase
+{
+    std::coroutine_handle<> continuation;
+    std::exception_ptr      exception;
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter        final_suspend() const noexcept { return {}; }
+    void                unhandled_exception() noexcept { exception = std::current_exception(); }
+};
+
+template <typename T> struct Promise : PromiseBase
+{
+    std::optional<T> value;
+
+    Task<T> get_return_object() noexcept;
+    void    return_value(T result) { value.emplace(std::move(result)); }
+};
+
+template <> struct Promise<void> : PromiseBase
+{
+    Task<void> get_return_object() noexcept;
+    void       return_void() const noexcept {}
+};
+
+/**
+    Eagerly started coroutine which nobody waits for and which frees itself when done.
+*/
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask       get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void               return_void() const noexcept {}
+        void               unhandled_exception() const noexcept { std::terminate(); }
+    };
+};
+} // namespace detail
+
+/**
+    Lazily started coroutine producing a T. It runs when it is first awaited and resumes its
+    awaiter when it finishes, on whatever thread it finished on.
+*/
+template <typename T> class Task
+{
+  public:
+    using promise_type = detail::Promise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle)
+            {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task()
+    {
+        if (handle)
+        {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+        handle.promise().continuation = awaiter;
+        return handle;
+    }
+
+    T await_resume()
+    {
+        promise_type& promise = handle.promise();
+        if (promise.exception)
+        {
+            std::rethrow_exception(promise.exception);
+        }
+        if constexpr (!std::is_void_v<T>)
+        {
+            return std::move(*promise.value);
+        }
+    }
+
+  private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+namespace detail
+{
+template <typename T> Task<T> Promise<T>::get_return_object() noexcept
+{
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() noexcept
+{
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+} // namespace detail
+
+/**
+    Start a task without waiting for it. The task owns itself until it finishes; an exception
+    escaping it terminates the program.
+*/
+inline void spawn(Task<void> task)
+{
+    [](Task<void> owned) -> detail::DetachedTask { co_await owned; }(std::move(task));
+}
+
+/**
+    Run a task and block the calling thread until it has finished.
+
+    \returns the result of the task, rethrowing any exception it ended with
+*/
+template <typename T> T sync_wait(Task<T> task)
+{
+    std::binary_semaphore done{0};
+    std::exception_ptr    error;
+    std::conditional_t<std::is_void_v<T>, bool, std::optional<T>> result{};
+
+    auto runner = [&]() -> detail::DetachedTask
+    {
+        try
+        {
+            if constexpr (std::is_void_v<T>)
+            {
+                co_await std::move(task);
+            }
+            else
+            {
+                result.emplace(co_await std::move(task));
+            }
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        done.release();
+    };
+    runner();
+    done.acquire();
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    if constexpr (!std::is_void_v<T>)
+    {
+        return std::move(*result);
+    }
+}
+} // namespace vtpl
+
+#endif // gpu_task_h
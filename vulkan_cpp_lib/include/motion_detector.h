@@ -0,0 +1,155 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef motion_detector_h
+#define motion_detector_h
+#include "engine.h"
+#include "gpu_memory.h"
+#include "submission_queue.h"
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vtpl
+{
+/**
+    Parameters of the motion kernel, shared by every stream of a detector.
+
+    Luma frames are downscaled 4x4 before they are compared with the background, so width
+    and height must be multiples of 4. The downscaled frame is split into a zonesX by zonesY
+    grid of zones; every zone reports how many downscaled pixels differ from the background
+    by more than threshold luma levels. The background moves 1/learningDivisor of the way
+    towards every new frame.
+*/
+struct MotionConfig
+{
+    uint32_t width{640};
+    uint32_t height{360};
+    uint32_t zonesX{4};
+    uint32_t zonesY{4};
+    uint32_t threshold{16};
+    uint32_t learningDivisor{16};
+};
+
+/**
+    How the motion kernel sums its zones.
+*/
+enum class MotionReduction
+{
+    // subgroup arithmetic where the device supports it, shared memory otherwise
+    Automatic,
+    SharedMemory,
+    Subgroup
+};
+
+/**
+    CPU implementation of the motion kernel for one stream, used to validate the GPU results.
+
+    \param config the kernel parameters
+    \param luma the new luma frame, width x height bytes
+    \param background the background model in 8.8 fixed point, resized on first use
+    \param initialize whether to reset the background to this frame instead of detecting
+    \returns the number of changed downscaled pixels per zone, row by row
+*/
+std::vector<uint32_t> motion_reference(const MotionConfig& config, const uint8_t* luma,
+                                       std::vector<uint32_t>& background, bool initialize);
+
+/**
+    Detects motion on many streams with one compute dispatch.
+
+    Every stream keeps its background model on the GPU. Frames are queued per stream and a
+    single dispatch processes all streams which got a new frame; only the per zone scores are
+    read back. The reduction uses subgroup arithmetic where the device supports it in compute
+    shaders and falls back to a shared memory reduction otherwise.
+*/
+class MotionDetector
+{
+  public:
+    /**
+        \param engine the engine to run on, must outlive the detector
+        \param streamCount number of streams
+        \param config the kernel parameters, throws std::invalid_argument when the frame size is
+        not a non zero multiple of 4, there are no zones or learningDivisor is 0
+        \param reduction the reduction to use, throws std::runtime_error when Subgroup is asked
+        for on a device which does not support it
+        \param submissionQueue when set, dispatches are pushed through it instead of being
+        submitted directly, must outlive the detector
+    */
+    MotionDetector(Engine& engine, uint32_t streamCount, MotionConfig config,
+                   MotionReduction reduction = MotionReduction::Automatic, SubmissionQueue* submissionQueue = nullptr);
+    ~MotionDetector();
+    MotionDetector(const MotionDetector&) = delete;
+    MotionDetector& operator=(const MotionDetector&) = delete;
+
+    /**
+        Queue a luma frame for the next detect. The first frame of a stream only initializes
+        its background.
+
+        \returns false if the stream is past the end
+    */
+    bool submit_luma(uint32_t stream, const uint8_t* luma);
+
+    /**
+        Reset the background of a stream to its next frame, e.g. after a camera moved.
+    */
+    void reset_background(uint32_t stream);
+
+    /**
+        Run the kernel over all streams with a queued frame and read back their zone scores.
+        Blocks until the GPU has finished.
+    */
+    void detect();
+
+    /**
+        \returns the number of changed downscaled pixels per zone of a stream, from the last
+        detect which had a frame for it
+    */
+    const uint32_t* zone_counts(uint32_t stream) const;
+
+    /**
+        \returns the fraction of changed downscaled pixels in a zone
+    */
+    float zone_score(uint32_t stream, uint32_t zone) const;
+
+    bool                uses_subgroups() const { return subgroupReduction; }
+    const MotionConfig& get_config() const { return config; }
+
+  private:
+    Engine&          engine;
+    SubmissionQueue* submissionQueue;
+    uint32_t         streamCount;
+    MotionConfig     config;
+    uint32_t         downWidth;
+    uint32_t         downHeight;
+    uint32_t         zoneCount;
+    bool             subgroupReduction{false};
+
+    // per stream state mirrored into the flags buffer
+    std::vector<bool>     initialized;
+    std::vector<uint32_t> zonePixels;
+    std::vector<uint32_t> lastCounts;
+
+    vtpl::Buffer lumaBuffer;
+    vtpl::Buffer backgroundBuffer;
+    vtpl::Buffer flagBuffer;
+    vtpl::Buffer scoreBuffer;
+    vtpl::Buffer scoreReadbackBuffer;
+
+    vk::DescriptorSetLayout descriptorSetLayout{nullptr};
+    vk::DescriptorPool      descriptorPool{nullptr};
+    vk::DescriptorSet       descriptorSet{nullptr};
+    vk::PipelineLayout      pipelineLayout{nullptr};
+    vk::Pipeline            pipeline{nullptr};
+    vk::CommandPool         commandPool{nullptr};
+    vk::CommandBuffer       commandBuffer{nullptr};
+    vk::Fence               fence{nullptr};
+
+    bool supports_subgroup_reduction() const;
+    void make_descriptors();
+    void record(const vk::CommandBuffer& cmd);
+};
+} // namespace vtpl
+
+#endif // motion_detector_h
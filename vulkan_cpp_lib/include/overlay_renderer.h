@@ -0,0 +1,216 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef overlay_renderer_h
+#define overlay_renderer_h
+#include "engine.h"
+#include "gpu_memory.h"
+#include "pipeline_variants.h"
+#include "tile_viewport.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vtpl
+{
+/**
+    Placement of one glyph inside an SDF atlas. The atlas rectangle is in normalized texture
+    coordinates, the quad offset and size and the advance are in em units relative to the
+    pen position on the baseline, with y pointing down.
+*/
+struct GlyphMetrics
+{
+    float u0{0.0f};
+    float v0{0.0f};
+    float u1{0.0f};
+    float v1{0.0f};
+    float offsetX{0.0f};
+    float offsetY{0.0f};
+    float width{0.0f};
+    float height{0.0f};
+    float advance{0.0f};
+};
+
+/**
+    Draws detection boxes, track polylines and text labels for all tiles of a video wall into
+    an offscreen target.
+
+    The CPU only appends compact records into a persistently mapped storage buffer. On render a
+    compute pass culls them against their tile viewport, compacts the visible ones and writes
+    the vkCmdDrawIndirect arguments, so the whole overlay is drawn with one instanced indirect
+    draw per primitive kind no matter how many records there are. Every kind is drawn with a
+    pipeline variant specialized on it, so the shaders carry no per kind branches.
+
+    Coordinates passed to the add functions are normalized to the tile, (0, 0) is its top left
+    corner and (1, 1) its bottom right one. Colors are packed as 0xAABBGGRR.
+*/
+class OverlayRenderer
+{
+  public:
+    /**
+        \param engine the engine to render with, must outlive the renderer
+        \param width width of the render target in pixels
+        \param height height of the render target in pixels
+        \param capacity maximum number of records per frame
+        \param maxTiles maximum number of tile viewports
+    */
+    OverlayRenderer(Engine& engine, uint32_t width, uint32_t height, uint32_t capacity = 65536,
+                    uint32_t maxTiles = 1024);
+    ~OverlayRenderer();
+    OverlayRenderer(const OverlayRenderer&) = delete;
+    OverlayRenderer& operator=(const OverlayRenderer&) = delete;
+
+    /**
+        Replace the tile layout. Records referring to tiles past the end are culled.
+
+        \returns false if there are more tiles than the renderer was created for
+    */
+    bool set_tiles(const std::vector<TileViewport>& tiles);
+
+    /**
+        Replace the glyph atlas used for labels.
+
+        \param atlasWidth width of the atlas in texels
+        \param atlasHeight height of the atlas in texels
+        \param sdf single channel signed distance field, 0.5 on the glyph outline
+        \param metrics metrics of every glyph in the atlas, keyed by character code
+    */
+    void set_glyph_atlas(uint32_t atlasWidth, uint32_t atlasHeight, const uint8_t* sdf,
+                         std::unordered_map<uint32_t, GlyphMetrics> metrics);
+
+    /**
+        Append the outline of a bounding box.
+
+        \returns false if the record buffer is full
+    */
+    bool add_box(uint32_t tile, float x0, float y0, float x1, float y1, uint32_t color, float thickness = 2.0f);
+
+    /**
+        Append a track polyline, one record per segment.
+
+        \returns false if the record buffer could not hold all segments
+    */
+    bool add_track(uint32_t tile, const std::vector<std::array<float, 2>>& points, uint32_t color,
+                   float thickness = 2.0f);
+
+    /**
+        Append a text label with its pen starting at (x, y) on the baseline. Characters
+        missing from the atlas are skipped.
+
+        \param pixelSize height of one em in target pixels
+        \returns false if the record buffer could not hold all glyphs
+    */
+    bool add_label(uint32_t tile, float x, float y, float pixelSize, const std::string& text, uint32_t color);
+
+    /**
+        Drop all appended records.
+    */
+    void clear() { primitiveCount = 0; }
+
+    /**
+        Cull and draw the appended records into the target and copy it to the readback buffer.
+        Blocks until the GPU has finished.
+    */
+    void render();
+
+    /**
+        \returns the last rendered frame as tightly packed RGBA8 rows
+    */
+    std::vector<uint8_t> readback() const;
+
+    /**
+        \returns the number of boxes, segments and glyphs which survived culling in the last frame
+    */
+    std::array<uint32_t, 3> visible_counts() const;
+
+    uint32_t           get_primitive_count() const { return primitiveCount; }
+    const vtpl::Image& get_target() const { return target; }
+
+  private:
+    // std430 layout of a record appended by the CPU, see overlay_cull.comp
+    struct Primitive
+    {
+        float    geom[4];
+        float    extra[4];
+        float    uv[4];
+        uint32_t tile;
+        uint32_t color;
+        uint32_t kind;
+        float    thickness;
+    };
+
+    // std430 layout of a record written by the cull pass, see overlay_cull.comp
+    struct Visible
+    {
+        float    geom[4];
+        float    uv[4];
+        float    clip[4];
+        uint32_t misc[4];
+    };
+
+    static_assert(sizeof(Primitive) == 64, "Primitive must match its std430 layout in overlay_cull.comp");
+    static_assert(sizeof(Visible) == 64, "Visible must match its std430 layout in overlay_cull.comp");
+
+    static constexpr vk::DeviceSize visibleStride = sizeof(Visible);
+    static constexpr uint32_t       kindCount = 3;
+
+    // the primitive kind overlay.vert and overlay.frag are specialized on
+    struct DrawKey
+    {
+        uint32_t kind;
+
+        constexpr std::array<uint32_t, 1> constants() const { return {kind}; }
+        constexpr bool                    operator==(const DrawKey&) const = default;
+    };
+
+    Engine&  engine;
+    uint32_t width;
+    uint32_t height;
+    uint32_t capacity;
+    uint32_t maxTiles;
+    uint32_t tileCount{0};
+    uint32_t primitiveCount{0};
+
+    std::unordered_map<uint32_t, GlyphMetrics> glyphs;
+
+    vtpl::Buffer primitiveBuffer;
+    vtpl::Buffer tileBuffer;
+    vtpl::Buffer visibleBuffer;
+    vtpl::Buffer drawBuffer;
+    vtpl::Buffer readbackBuffer;
+    vtpl::Buffer countBuffer;
+    vtpl::Image  target;
+    vtpl::Image  glyphAtlas;
+
+    vk::Sampler             atlasSampler{nullptr};
+    vk::DescriptorSetLayout descriptorSetLayout{nullptr};
+    vk::DescriptorPool      descriptorPool{nullptr};
+    vk::DescriptorSet       descriptorSet{nullptr};
+    vk::PipelineLayout      pipelineLayout{nullptr};
+    vk::Pipeline            cullPipeline{nullptr};
+    vk::RenderPass          renderPass{nullptr};
+    vk::Framebuffer         framebuffer{nullptr};
+    vk::CommandPool         commandPool{nullptr};
+    vk::CommandBuffer       commandBuffer{nullptr};
+    vk::Fence               fence{nullptr};
+
+    std::unique_ptr<PipelineVariants<DrawKey>> drawPipelines;
+    // resolved from drawPipelines on the first frame, so later frames skip the variant lookup
+    std::array<vk::Pipeline, kindCount> kindPipelines{};
+
+    bool push(const Primitive& primitive);
+    void make_descriptors();
+    void write_atlas_descriptor();
+    void make_render_pass();
+    void make_pipelines();
+    void record(const vk::CommandBuffer& cmd);
+};
+} // namespace vtpl
+
+#endif // overlay_renderer_h
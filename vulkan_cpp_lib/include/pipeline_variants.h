@@ -0,0 +1,252 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef pipeline_variants_h
+#define pipeline_variants_h
+#include "engine.h"
+#include <array>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vtpl
+{
+/**
+    A pipeline variant key is a plain struct of the options a shader is specialized on. Its
+    constants() returns them as 32 bit values in constant_id order, so field i becomes
+    layout(constant_id = i) in the shader. Enums and bools are cast to uint32_t, which
+    matches both int/uint and bool specialization constants.
+
+        struct ConvertKey
+        {
+            ColorMatrix matrix;
+            bool        fullRange;
+            uint32_t    subgroupSize;
+
+            constexpr std::array<uint32_t, 3> constants() const
+            {
+                return {static_cast<uint32_t>(matrix), fullRange, subgroupSize};
+            }
+            constexpr bool operator==(const ConvertKey&) const = default;
+        };
+*/
+template <typename Key>
+concept PipelineVariantKey = std::equality_comparable<Key> && requires(const Key& key) {
+    { key.constants()[0] } -> std::convertible_to<uint32_t>;
+    std::tuple_size<std::remove_cvref_t<decltype(key.constants())>>::value;
+};
+
+/**
+    FNV-1a over the specialization constants of a key. It is constexpr, so keys known at
+    compile time are hashed by the compiler.
+*/
+template <PipelineVariantKey Key> constexpr uint64_t variant_hash(const Key& key)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (uint32_t value : key.constants())
+    {
+        for (uint32_t byte = 0; byte < 4; byte++)
+        {
+            hash ^= (value >> (8 * byte)) & 0xFFU;
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+/**
+    Compiles and keeps the pipeline variants of one shader, keyed by a PipelineVariantKey.
+
+    Each variant is compiled once with its key turned into specialization constants, so the
+    shader branches are resolved by the driver compiler instead of at run time. Variants are
+    compiled lazily on first use, or ahead of time on a background thread by prewarm().
+    Several threads may ask for variants at once; a variant being compiled is waited for
+    rather than compiled twice.
+
+    Lookups take a shared lock and a hash, so hot loops should resolve their pipeline once
+    outside the loop and keep the vk::Pipeline.
+*/
+template <PipelineVariantKey Key> class PipelineVariants
+{
+  public:
+    /**
+        Builds one variant, typically by calling make_compute_pipeline or
+        make_graphics_pipeline with the given specialization.
+    */
+    using Factory = std::function<vk::Pipeline(const vk::SpecializationInfo& specialization)>;
+
+    /**
+        \param engine the engine owning the device, must outlive the cache
+        \param factory builds the pipeline of a variant
+    */
+    PipelineVariants(Engine& engine, Factory factory) : engine(engine), factory(std::move(factory)) {}
+
+    ~PipelineVariants()
+    {
+        {
+            std::lock_guard<std::mutex> lock(prewarmMutex);
+            stopping = true;
+        }
+        prewarmWakeup.notify_one();
+        if (prewarmThread.joinable())
+        {
+            prewarmThread.join();
+        }
+        for (auto& [key, pipeline] : variants)
+        {
+            engine.get_device().destroyPipeline(pipeline.get());
+        }
+    }
+
+    PipelineVariants(const PipelineVariants&) = delete;
+    PipelineVariants& operator=(const PipelineVariants&) = delete;
+
+    /**
+        \returns the pipeline of the variant, compiling it first if needed. Rethrows when
+        the compilation fails, and tries again on the next call.
+    */
+    vk::Pipeline get(const Key& key)
+    {
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto                                found = variants.find(key);
+            if (found != variants.end())
+            {
+                std::shared_future<vk::Pipeline> pipeline = found->second;
+                lock.unlock();
+                return pipeline.get();
+            }
+        }
+
+        std::promise<vk::Pipeline> promise;
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            auto [found, inserted] = variants.try_emplace(key, promise.get_future().share());
+            if (!inserted)
+            {
+                // another thread got there first
+                std::shared_future<vk::Pipeline> pipeline = found->second;
+                lock.unlock();
+                return pipeline.get();
+            }
+        }
+
+        try
+        {
+            vk::Pipeline pipeline = compile(key);
+            promise.set_value(pipeline);
+            return pipeline;
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            variants.erase(key);
+            throw;
+        }
+    }
+
+    /**
+        Queue variants for compilation on a background thread, so their first use does not
+        stall. Returns at once; failures are left for get() to report.
+    */
+    void prewarm(const std::vector<Key>& keys)
+    {
+        {
+            std::lock_guard<std::mutex> lock(prewarmMutex);
+            prewarmQueue.insert(prewarmQueue.end(), keys.begin(), keys.end());
+            if (!prewarmThread.joinable())
+            {
+                prewarmThread = std::thread(&PipelineVariants::run_prewarm, this);
+            }
+        }
+        prewarmWakeup.notify_one();
+    }
+
+    /**
+        \returns the number of variants compiled or being compiled
+    */
+    size_t size() const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return variants.size();
+    }
+
+  private:
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const { return static_cast<size_t>(variant_hash(key)); }
+    };
+
+    Engine&                                                            engine;
+    Factory                                                            factory;
+    mutable std::shared_mutex                                          mutex;
+    std::unordered_map<Key, std::shared_future<vk::Pipeline>, KeyHash> variants;
+
+    // keys waiting for the prewarm thread, which is started by the first prewarm()
+    std::mutex              prewarmMutex;
+    std::condition_variable prewarmWakeup;
+    std::deque<Key>         prewarmQueue;
+    bool                    stopping{false};
+    std::thread             prewarmThread;
+
+    void run_prewarm()
+    {
+        for (;;)
+        {
+            std::optional<Key> key;
+            {
+                std::unique_lock<std::mutex> lock(prewarmMutex);
+                prewarmWakeup.wait(lock, [this] { return stopping || !prewarmQueue.empty(); });
+                if (stopping)
+                {
+                    return;
+                }
+                key.emplace(std::move(prewarmQueue.front()));
+                prewarmQueue.pop_front();
+            }
+            try
+            {
+                (void)get(*key);
+            }
+            catch (...)
+            {
+            }
+        }
+    }
+
+    vk::Pipeline compile(const Key& key) const
+    {
+        const auto       constants = key.constants();
+        constexpr size_t count = std::tuple_size_v<std::remove_cv_t<decltype(constants)>>;
+
+        std::array<uint32_t, count>                   values{};
+        std::array<vk::SpecializationMapEntry, count> entries{};
+        for (uint32_t i = 0; i < count; i++)
+        {
+            values[i] = static_cast<uint32_t>(constants[i]);
+            entries[i] = vk::SpecializationMapEntry(i, i * sizeof(uint32_t), sizeof(uint32_t));
+        }
+        vk::SpecializationInfo specialization =
+            vk::SpecializationInfo(static_cast<uint32_t>(count), entries.data(), sizeof(values), values.data());
+        return factory(specialization);
+    }
+};
+} // namespace vtpl
+
+#endif // pipeline_variants_h
@@ -0,0 +1,227 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef residency_cache_h
+#define residency_cache_h
+#include "engine.h"
+#include "gpu_memory.h"
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vtpl
+{
+/**
+    Budget and usage of one memory heap as seen by a residency cache.
+*/
+struct HeapUsage
+{
+    // what the cache allows itself to fill the heap up to
+    vk::DeviceSize budget{0};
+    // everything allocated from the heap; only the cache's own share without VK_EXT_memory_budget
+    vk::DeviceSize usage{0};
+    // the part of usage held by the cache
+    vk::DeviceSize cached{0};
+};
+
+/**
+    Counters of a residency cache since it was created.
+*/
+struct ResidencyStats
+{
+    uint64_t       hits{0};
+    uint64_t       misses{0};
+    uint64_t       evictions{0};
+    vk::DeviceSize evictedBytes{0};
+    // allocations made over budget because nothing evictable was left
+    uint64_t overBudget{0};
+};
+
+/**
+    Keeps textures and buffers resident within the device memory budget.
+
+    Every resource lives in one memory heap. Before a new resource is allocated, the least
+    recently used resources of that heap which are not pinned are destroyed until it fits
+    under the budget. The budget comes from VK_EXT_memory_budget when the device has it, so
+    memory taken by other processes is accounted for; otherwise it is a share of the heap size.
+
+    Resources are only handed out as leases, which pin them under the cache lock and unpin
+    them when they go out of scope, so no other thread can evict a resource between looking
+    it up and using it. Evicted resources are destroyed immediately, so a lease must be kept
+    until the GPU work using its resource has finished.
+*/
+class ResidencyCache
+{
+  public:
+    using Key = uint64_t;
+
+    /**
+        A pinned resource of the cache, unpinned when the lease is destroyed. An empty lease
+        stands for a miss.
+    */
+    template <typename Resource> class Lease
+    {
+      public:
+        Lease() = default;
+        ~Lease() { release(); }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease(Lease&& other) noexcept : cache(other.cache), key(other.key), resource(other.resource)
+        {
+            other.cache = nullptr;
+        }
+        Lease& operator=(Lease&& other) noexcept
+        {
+            if (this != &other)
+            {
+                release();
+                cache = other.cache;
+                key = other.key;
+                resource = other.resource;
+                other.cache = nullptr;
+            }
+            return *this;
+        }
+
+        explicit operator bool() const { return cache != nullptr; }
+        const Resource& operator*() const { return resource; }
+        const Resource* operator->() const { return &resource; }
+        Key             get_key() const { return key; }
+
+        /**
+            Unpin the resource early, the lease is empty afterwards.
+        */
+        void release()
+        {
+            if (cache != nullptr)
+            {
+                cache->unpin(key);
+                cache = nullptr;
+            }
+        }
+
+      private:
+        friend class ResidencyCache;
+        Lease(ResidencyCache* cache, Key key, Resource resource) : cache(cache), key(key), resource(resource) {}
+
+        ResidencyCache* cache{nullptr};
+        Key             key{0};
+        Resource        resource{};
+    };
+
+    using ImageLease = Lease<Image>;
+    using BufferLease = Lease<Buffer>;
+
+    /**
+        \param engine the engine owning the device, must outlive the cache
+        \param budgetFraction share of each heap budget the cache may fill
+        \param byteLimit most bytes the cache itself may hold in any one heap, 0 for no limit
+        besides the heap budget
+    */
+    explicit ResidencyCache(Engine& engine, float budgetFraction = 0.8f, vk::DeviceSize byteLimit = 0);
+    ~ResidencyCache();
+    ResidencyCache(const ResidencyCache&) = delete;
+    ResidencyCache& operator=(const ResidencyCache&) = delete;
+
+    /**
+        Look up an image, mark it as most recently used and pin it for the lifetime of the lease.
+
+        \returns the leased image, or an empty lease on a miss
+    */
+    ImageLease acquire_image(Key key);
+
+    /**
+        Look up a buffer, mark it as most recently used and pin it for the lifetime of the lease.
+
+        \returns the leased buffer, or an empty lease on a miss
+    */
+    BufferLease acquire_buffer(Key key);
+
+    /**
+        Create a device local image under the given key, evicting to make room for it. A
+        resource already stored under the key is replaced, unless it is pinned, which throws
+        std::runtime_error.
+
+        \param pinned whether the image also keeps a pin of its own after the lease is gone,
+        e.g. for last-good frames; it is released with unpin
+        \returns the leased image, in undefined layout
+    */
+    ImageLease insert_image(Key key, vk::Extent2D extent, vk::Format format, vk::ImageUsageFlags usage,
+                            uint32_t mipLevels = 1, bool pinned = false);
+
+    /**
+        Create a buffer under the given key, evicting to make room for it. A resource already
+        stored under the key is replaced, unless it is pinned, which throws std::runtime_error.
+
+        \param pinned whether the buffer also keeps a pin of its own after the lease is gone
+        \returns the leased buffer, mapped if the memory is host visible
+    */
+    BufferLease insert_buffer(Key key, vk::DeviceSize size, vk::BufferUsageFlags usage,
+                              vk::MemoryPropertyFlags properties, bool pinned = false);
+
+    /**
+        Protect a resource from eviction beyond the lifetime of any lease. Pins nest, every pin
+        needs a matching unpin.
+    */
+    void pin(Key key);
+    void unpin(Key key);
+
+    /**
+        Destroy a resource right away.
+
+        \returns false if the resource is pinned, it is then left alone
+    */
+    bool erase(Key key);
+
+    /**
+        \returns the budget and usage of every memory heap
+    */
+    std::vector<HeapUsage> heap_usage() const;
+
+    /**
+        \returns the counters so far
+    */
+    ResidencyStats stats() const;
+
+  private:
+    struct Entry
+    {
+        std::optional<Image>     image;
+        std::optional<Buffer>    buffer;
+        uint32_t                 heap{0};
+        vk::DeviceSize           bytes{0};
+        uint32_t                 pins{0};
+        std::list<Key>::iterator recent;
+    };
+
+    Engine&                            engine;
+    float                              budgetFraction;
+    vk::DeviceSize                     byteLimit;
+    vk::PhysicalDeviceMemoryProperties memoryProperties;
+
+    mutable std::mutex             mutex;
+    std::unordered_map<Key, Entry> entries;
+    // most recently used first
+    std::list<Key>              recency;
+    std::vector<vk::DeviceSize> cachedBytes;
+    ResidencyStats              counters;
+
+    uint32_t               heap_of(const vk::MemoryRequirements& requirements,
+                                   vk::MemoryPropertyFlags properties) const;
+    std::vector<HeapUsage> query_heaps() const;
+    void                   make_room(uint32_t heap, vk::DeviceSize bytes);
+    bool                   evict_one(uint32_t heap);
+    void                   replace_locked(Key key);
+    void                   erase_locked(Key key);
+    void                   destroy(Entry& entry);
+    void                   store(Key key, Entry entry);
+};
+} // namespace vtpl
+
+#endif // residency_cache_h
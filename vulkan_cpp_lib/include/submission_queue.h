@@ -0,0 +1,152 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef submission_queue_h
+#define submission_queue_h
+#include "engine.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vtpl
+{
+/**
+    One unit of work for the submission queue, the equivalent of a single vk::SubmitInfo.
+*/
+struct SubmitPacket
+{
+    std::vector<vk::CommandBuffer>      commandBuffers;
+    std::vector<vk::Semaphore>          waitSemaphores;
+    std::vector<vk::PipelineStageFlags> waitStages;
+    std::vector<vk::Semaphore>          signalSemaphores;
+    // signalled once this packet and every packet merged into the same submit has finished
+    vk::Fence fence{nullptr};
+    // called on the submission thread once the packet was handed to the driver, with the
+    // error if the driver refused it; the fence of a refused packet is never signalled
+    std::function<void(vk::Result)> onSubmit;
+};
+
+/**
+    Counters of a submission queue since it was created, except for the rate which covers the
+    interval since the previous stats() call.
+*/
+struct SubmissionStats
+{
+    uint64_t packets{0};
+    uint64_t submits{0};
+    uint64_t failedSubmits{0};
+    uint64_t failedPackets{0};
+    // the most packets one successful submit carried
+    size_t maxBatch{0};
+    double   meanBatch{0.0};
+    // time from push() until the packet was handed to the driver
+    std::chrono::microseconds meanQueueingDelay{0};
+    std::chrono::microseconds maxQueueingDelay{0};
+    // successful submits per second since the previous stats() call
+    double submitsPerSecond{0.0};
+};
+
+/**
+    Multi-producer front-end for the engine queue.
+
+    Producer threads push packets into a lock-free queue and never touch the vk::Queue. A
+    single owner thread drains it and merges whatever has arrived into one vkQueueSubmit,
+    so stream threads no longer contend on the queue lock and the driver sees few, large
+    submits. A packet carrying a fence closes its batch, since a submit signals one fence.
+    When the driver refuses a batch its packets are retried one by one, so a bad packet only
+    fails itself, and every packet learns its outcome through its onSubmit callback.
+*/
+class SubmissionQueue
+{
+  public:
+    /**
+        \param engine the engine whose queue the work goes to, must outlive the queue
+        \param latencyBudget how long the owner thread may hold the oldest packet back while
+        waiting for more work to merge with it, zero submits whatever is already queued
+        \param maxBatch the most packets merged into one submit
+    */
+    explicit SubmissionQueue(Engine& engine, std::chrono::microseconds latencyBudget = std::chrono::microseconds(0),
+                             size_t maxBatch = 64);
+    ~SubmissionQueue();
+    SubmissionQueue(const SubmissionQueue&) = delete;
+    SubmissionQueue& operator=(const SubmissionQueue&) = delete;
+
+    /**
+        Queue work for submission. Safe to call from any number of threads.
+    */
+    void push(SubmitPacket packet);
+
+    /**
+        Queue work and block until the owner thread handed it to the driver, for callers which
+        wait on the fence of the packet right after. Throws std::runtime_error when the driver
+        refused the packet, its fence is then never signalled.
+    */
+    void submit(SubmitPacket packet);
+
+    /**
+        \returns the counters so far, and starts a new interval for the submit rate
+    */
+    SubmissionStats stats();
+
+  private:
+    struct Queued
+    {
+        SubmitPacket                          packet;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    struct Node
+    {
+        std::atomic<Node*> next{nullptr};
+        Queued             item;
+    };
+
+    Engine&                               engine;
+    std::chrono::microseconds             latencyBudget;
+    size_t                                maxBatch;
+
+    // intrusive MPSC list: producers swap themselves into head, the owner thread pops at tail
+    std::atomic<Node*>    head;
+    Node*                 tail;
+    std::atomic<uint32_t> signal{0};
+    std::atomic<bool>     stopping{false};
+
+    // the owner thread sleeps here, producers only take the lock while it is sleeping
+    std::mutex              waitMutex;
+    std::condition_variable wakeup;
+    std::atomic<bool>       sleeping{false};
+
+    std::atomic<uint64_t> packets{0};
+    std::atomic<uint64_t> submits{0};
+    std::atomic<uint64_t> failedSubmits{0};
+    std::atomic<uint64_t> failedPackets{0};
+    std::atomic<size_t>   maxBatchSeen{0};
+    std::atomic<uint64_t> totalDelayNs{0};
+    std::atomic<uint64_t> maxDelayNs{0};
+
+    // start of the current submit rate interval
+    std::mutex                            statsMutex;
+    std::chrono::steady_clock::time_point intervalStart;
+    uint64_t                              intervalSubmits{0};
+
+    std::thread thread;
+
+    Node*      pop();
+    void       wake();
+    void       wait_for_signal(uint32_t seen);
+    void       wait_for_signal(uint32_t seen, std::chrono::steady_clock::time_point deadline);
+    vk::Result submit_packets(const Queued* first, size_t count);
+    void       submit_batch(const std::vector<Queued>& batch);
+    void       run();
+};
+} // namespace vtpl
+
+#endif // submission_queue_h
@@ -0,0 +1,192 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef swapchain_h
+#define swapchain_h
+#include "engine.h"
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vtpl
+{
+/**
+    How presented images are paced against the display.
+*/
+enum class PresentMode
+{
+    // wait for vertical blank, always available
+    Fifo,
+    // replace the queued image at vertical blank, lowest latency without tearing
+    Mailbox,
+    // present at once, may tear
+    Immediate
+};
+
+/**
+    Presentation timing of a swapchain since it was created.
+*/
+struct PresentStats
+{
+    uint64_t presents{0};
+    uint64_t recreations{0};
+    // time between consecutive presents, i.e. the pacing the display gets
+    std::chrono::microseconds meanInterval{0};
+    std::chrono::microseconds minInterval{0};
+    std::chrono::microseconds maxInterval{0};
+    std::chrono::microseconds intervalJitter{0};
+    // time from acquiring an image to presenting it
+    std::chrono::microseconds meanFrameLatency{0};
+    std::chrono::microseconds maxFrameLatency{0};
+};
+
+/**
+    One acquired swapchain image. Its work goes to Swapchain::submit, which waits on acquired
+    and signals rendered and the fence of the frame slot; the work must leave the image in
+    present source layout.
+*/
+struct SwapchainFrame
+{
+    uint32_t      imageIndex{0};
+    uint32_t      slot{0};
+    vk::Image     image{nullptr};
+    vk::ImageView view{nullptr};
+    vk::Semaphore acquired{nullptr};
+    vk::Semaphore rendered{nullptr};
+};
+
+/**
+    Swapchain over a GLFW window surface or a VK_EXT_headless_surface one.
+
+    The swapchain is rebuilt on resize, on a present mode change and whenever the surface
+    reports it out of date. The old swapchain is handed over as oldSwapchain and destroyed
+    once the frames which used it have finished, so recreation never waits for the device
+    to go idle.
+*/
+class Swapchain
+{
+  public:
+    /**
+        \param engine the engine to present with, must outlive the swapchain
+        \param surface the surface to present to, owned and destroyed by the swapchain
+        \param extent the size to use when the surface does not dictate one
+        \param presentMode the requested present mode, FIFO is used when it is unavailable
+        \param imageCount the requested number of images, clamped to what the surface allows
+        \param framesInFlight how many frames may be recorded before the oldest has finished
+    */
+    Swapchain(Engine& engine, vk::SurfaceKHR surface, vk::Extent2D extent, PresentMode presentMode = PresentMode::Fifo,
+              uint32_t imageCount = 3, uint32_t framesInFlight = 2);
+    ~Swapchain();
+    Swapchain(const Swapchain&) = delete;
+    Swapchain& operator=(const Swapchain&) = delete;
+
+    /**
+        Create a surface which is not backed by any display, for presenting on CI machines.
+
+        \param engine the engine whose instance enabled VK_EXT_headless_surface
+        \returns the surface, throws std::runtime_error when headless surfaces are unavailable
+    */
+    static vk::SurfaceKHR make_headless_surface(const Engine& engine);
+
+    /**
+        Acquire the next image, rebuilding the swapchain first if it is out of date. Blocks
+        until the frame which last used the same frame slot has finished. A frame of the slot
+        which was acquired but never submitted is retired here without work.
+
+        \returns the frame, or nothing while the surface has zero size
+    */
+    std::optional<SwapchainFrame> acquire();
+
+    /**
+        Submit the work of a frame returned by acquire. The fence of the frame slot is only
+        reset here, so an acquired frame which is dropped never leaves acquire or the
+        destructor waiting for it.
+
+        \param commandBuffers the work rendering or copying into the frame's image
+    */
+    void submit(const SwapchainFrame& frame, vk::ArrayProxy<const vk::CommandBuffer> commandBuffers);
+
+    /**
+        Present a frame once it has been submitted.
+    */
+    void present(const SwapchainFrame& frame);
+
+    /**
+        Rebuild the swapchain at the next acquire with a new size.
+    */
+    void resize(vk::Extent2D extent);
+
+    /**
+        Rebuild the swapchain at the next acquire with a new present mode.
+    */
+    void set_present_mode(PresentMode presentMode);
+
+    vk::Format   get_format() const { return format; }
+    vk::Extent2D get_extent() const { return extent; }
+    PresentMode  get_present_mode() const { return activeMode; }
+    uint32_t     get_image_count() const { return static_cast<uint32_t>(images.size()); }
+
+    // color attachment always, transfer destination only where the surface supports it
+    vk::ImageUsageFlags get_usage() const { return usage; }
+
+    /**
+        \returns the presentation timing so far
+    */
+    PresentStats stats() const;
+
+  private:
+    // a replaced swapchain, kept until the last frame which may use it has finished
+    struct Retired
+    {
+        vk::SwapchainKHR           swapchain;
+        std::vector<vk::ImageView> views;
+        std::vector<vk::Semaphore> rendered;
+        uint64_t                   retiredAt;
+    };
+
+    Engine&        engine;
+    vk::SurfaceKHR surface;
+    vk::Extent2D   requestedExtent;
+    PresentMode    requestedMode;
+    uint32_t       requestedImageCount;
+    bool           outOfDate{true};
+
+    vk::SwapchainKHR           swapchain{nullptr};
+    vk::Format                 format{vk::Format::eUndefined};
+    vk::ImageUsageFlags        usage;
+    vk::Extent2D               extent{0, 0};
+    PresentMode                activeMode{PresentMode::Fifo};
+    std::vector<vk::Image>     images;
+    std::vector<vk::ImageView> views;
+    // per image, since presentation may hold on to them after the frame slot is reused
+    std::vector<vk::Semaphore> rendered;
+    std::vector<Retired>       retired;
+
+    // per frame slot, unsubmitted marks slots whose acquired semaphore is still to be waited on
+    std::vector<vk::Semaphore>                         acquired;
+    std::vector<vk::Fence>                             fences;
+    std::vector<bool>                                  unsubmitted;
+    std::vector<std::chrono::steady_clock::time_point> acquireTimes;
+    uint64_t                                           frameNumber{0};
+
+    mutable std::mutex                    statsMutex;
+    PresentStats                          counters;
+    std::chrono::steady_clock::time_point lastPresent;
+    double                                intervalMean{0.0};
+    double                                intervalM2{0.0};
+    double                                latencySum{0.0};
+
+    void recreate();
+    void retire_unsubmitted(size_t slot);
+    void release_retired(bool all);
+    void destroy_all();
+    void record_present(std::chrono::steady_clock::time_point acquiredAt);
+};
+} // namespace vtpl
+
+#endif // swapchain_h
@@ -0,0 +1,205 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef telemetry_h
+#define telemetry_h
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace vtpl
+{
+/**
+    Pipeline stages whose latency is tracked per stream.
+*/
+enum class Stage : uint8_t
+{
+    Upload,
+    Composite,
+    Readback
+};
+
+constexpr size_t stageCount = 3;
+
+/**
+    Log-linear latency histogram in the style of HdrHistogram: every power of two is split
+    into 8 linear buckets, so a bucket is never more than 12.5% wide, from 1 ns up to about
+    18 minutes. It has a single writer, its owning thread, and may be read from any thread.
+*/
+class LatencyHistogram
+{
+  public:
+    static constexpr uint32_t subBuckets = 8;
+    static constexpr uint32_t maxMagnitude = 40;
+    static constexpr uint32_t bucketCount = (maxMagnitude - 1) * subBuckets;
+
+    void record(uint64_t nanoseconds) noexcept
+    {
+        // single writer, so a plain load and store avoids a locked read-modify-write
+        std::atomic<uint64_t>& bucket = buckets[bucket_index(nanoseconds)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    /**
+        \returns the count of every bucket
+    */
+    std::array<uint64_t, bucketCount> snapshot() const noexcept;
+
+    /**
+        \returns the bucket a value falls into
+    */
+    static uint32_t bucket_index(uint64_t nanoseconds) noexcept;
+
+    /**
+        \returns the largest value which falls into the bucket
+    */
+    static uint64_t bucket_upper(uint32_t index) noexcept;
+
+  private:
+    std::array<std::atomic<uint64_t>, bucketCount> buckets{};
+};
+
+/**
+    Process wide per-stream and per-stage counters, exported to the session folder.
+
+    Samples go into histograms owned by the recording thread, so recording takes no lock
+    and touches no shared cache line. An export thread periodically merges all threads and
+    appends one JSON line per interval to a file in the CoreContext session folder, with
+    latency percentiles, dropped frames and queue depth of every stream over that interval.
+
+    Nothing is exported until start_export is called, which executables do once the
+    CoreContext session folder is set, see vulkan_cpp_exe. Without it the counters are
+    still kept and export_now can write a line on demand.
+*/
+class Telemetry
+{
+  public:
+    // stream id for work which is not tied to a single stream
+    static constexpr uint32_t allStreams = UINT32_MAX;
+
+    static Telemetry& instance();
+    Telemetry(const Telemetry&) = delete;
+    Telemetry& operator=(const Telemetry&) = delete;
+
+    /**
+        Record how long a stage took for a stream.
+    */
+    void record(uint32_t stream, Stage stage, std::chrono::nanoseconds latency);
+
+    /**
+        Count frames of a stream which were dropped before they were shown.
+    */
+    void count_dropped(uint32_t stream, uint64_t frames = 1);
+
+    /**
+        Report how many items are queued for a stream right now. Takes no lock once the
+        stream has reported a depth before.
+    */
+    void set_queue_depth(uint32_t stream, uint64_t depth);
+
+    /**
+        Start appending a line to the export file every interval. Restarts the export if
+        it is already running.
+
+        \param interval time between two lines
+        \param fileName name of the file inside the session folder
+    */
+    void start_export(std::chrono::milliseconds interval = std::chrono::milliseconds(10000),
+                      const std::string& fileName = "telemetry.jsonl");
+
+    /**
+        Stop the periodic export after writing a last line.
+    */
+    void stop_export();
+
+    /**
+        Append a line covering everything recorded since the previous one.
+    */
+    void export_now();
+
+  private:
+    struct StreamData
+    {
+        std::array<LatencyHistogram, stageCount> stages;
+        std::atomic<uint64_t>                    dropped{0};
+    };
+
+    struct ThreadData
+    {
+        std::unordered_map<uint32_t, std::unique_ptr<StreamData>> streams;
+    };
+
+    // totals of a stream at the previous export
+    struct Exported
+    {
+        std::array<std::array<uint64_t, LatencyHistogram::bucketCount>, stageCount> stages{};
+        uint64_t                                                                     dropped{0};
+    };
+
+    // written by any thread, the export resets peak to current
+    struct QueueDepth
+    {
+        std::atomic<uint64_t> current{0};
+        std::atomic<uint64_t> peak{0};
+    };
+
+    Telemetry() = default;
+    ~Telemetry();
+
+    std::mutex                               mutex;
+    std::vector<std::unique_ptr<ThreadData>> threads;
+    std::map<uint32_t, Exported>             exported;
+    std::chrono::steady_clock::time_point    lastExport{std::chrono::steady_clock::now()};
+
+    // entries are never removed, so their addresses can be cached per thread
+    std::shared_mutex                                         depthMutex;
+    std::unordered_map<uint32_t, std::unique_ptr<QueueDepth>> queueDepths;
+
+    std::mutex              exportMutex;
+    std::condition_variable exportWakeup;
+    bool                    exportStopping{false};
+    std::string             exportPath;
+    std::thread             exportThread;
+
+    // the calling thread's data and the stream it recorded last, nearly always the next one
+    static thread_local ThreadData* localThread;
+    static thread_local uint32_t    localStream;
+    static thread_local StreamData* localData;
+    static thread_local uint32_t    localDepthStream;
+    static thread_local QueueDepth* localDepth;
+
+    StreamData& local_stream(uint32_t stream);
+    QueueDepth& queue_depth(uint32_t stream);
+};
+
+/**
+    Records the time between its construction and destruction as a stage of a stream.
+*/
+class StageTimer
+{
+  public:
+    StageTimer(uint32_t stream, Stage stage) : stream(stream), stage(stage), start(std::chrono::steady_clock::now()) {}
+    ~StageTimer() { Telemetry::instance().record(stream, stage, std::chrono::steady_clock::now() - start); }
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+  private:
+    uint32_t                              stream;
+    Stage                                 stage;
+    std::chrono::steady_clock::time_point start;
+};
+} // namespace vtpl
+
+#endif // telemetry_h
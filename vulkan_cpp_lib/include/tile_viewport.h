@@ -0,0 +1,23 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef tile_viewport_h
+#define tile_viewport_h
+
+namespace vtpl
+{
+/**
+    Placement of one video tile inside a render target, in pixels.
+*/
+struct TileViewport
+{
+    float x{0.0f};
+    float y{0.0f};
+    float width{0.0f};
+    float height{0.0f};
+};
+} // namespace vtpl
+
+#endif // tile_viewport_h
@@ -0,0 +1,128 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef trace_replay_h
+#define trace_replay_h
+#include "command_trace.h"
+#include "engine.h"
+#include "gpu_memory.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vtpl
+{
+/**
+    Outcome of replaying a command trace.
+*/
+struct ReplayStats
+{
+    uint64_t submits{0};
+    uint64_t dispatches{0};
+    uint64_t copies{0};
+    uint64_t draws{0};
+    uint64_t uploads{0};
+    uint64_t uploadedBytes{0};
+    // dispatches, copies and draws on resources created before the trace was started
+    uint64_t skipped{0};
+    // wall time of every frame, from the end of the previous one until its work finished
+    std::vector<std::chrono::nanoseconds> frameTimes;
+};
+
+/**
+    Re-runs a command trace written by CommandTrace as fast as the device allows.
+
+    Resources are recreated with their recorded sizes, formats and usage, and dispatches and
+    draws are run with the recorded shaders, bindings, push constants and sizes. Stored upload
+    payloads are replayed verbatim, the others with deterministic filler data of the same
+    size, so the transfer and cache load matches the recording while the content does not.
+    Copies into images are replayed with their recorded regions. Every image is kept in the
+    general layout, and every submission is waited for before the next one is made, as the
+    library itself does.
+
+    Only what the library records is replayed: uploads, copies into images, dispatches and
+    the draws of the wall compositor. The indirect draws of the overlay renderer, clears and
+    copies out of images are not part of a trace.
+*/
+class TraceReplay
+{
+  public:
+    /**
+        \param engine the engine to replay on, which must not be recording a trace itself
+        \param path the trace file, read completely before replay starts
+    */
+    TraceReplay(Engine& engine, const std::string& path);
+    ~TraceReplay();
+    TraceReplay(const TraceReplay&) = delete;
+    TraceReplay& operator=(const TraceReplay&) = delete;
+
+    /**
+        Replay the whole trace once. May be called again to replay it another time. The
+        pipelines are compiled when the trace is loaded, so no run pays for compilation.
+
+        \returns the counters and frame times of this run
+    */
+    ReplayStats run();
+
+  private:
+    // compute pipeline for a shader with a number of storage buffers and push constant bytes
+    struct Compute
+    {
+        vk::DescriptorSetLayout setLayout{nullptr};
+        vk::PipelineLayout      layout{nullptr};
+        vk::Pipeline            pipeline{nullptr};
+    };
+
+    // graphics pipeline for a pair of shaders with storage buffers, one sampled image and
+    // push constant bytes, drawing into images of one format
+    struct Graphics
+    {
+        vk::DescriptorSetLayout setLayout{nullptr};
+        vk::PipelineLayout      layout{nullptr};
+        vk::RenderPass          renderPass{nullptr};
+        vk::Pipeline            pipeline{nullptr};
+    };
+
+    Engine&                  engine;
+    std::vector<TraceRecord> records;
+    // whether the trace marks frames, otherwise every submission is a frame
+    bool                 hasFrames{false};
+    std::vector<uint8_t> filler;
+
+    std::unordered_map<uint32_t, Buffer>          buffers;
+    std::unordered_map<uint32_t, Image>           images;
+    std::unordered_map<uint32_t, vk::Framebuffer> framebuffers;
+    std::map<std::string, Compute>                pipelines;
+    std::map<std::string, Graphics>               graphicsPipelines;
+
+    vk::Sampler           sampler{nullptr};
+    vk::DescriptorPool    descriptorPool{nullptr};
+    vk::CommandPool       commandPool{nullptr};
+    vk::CommandBuffer     commandBuffer{nullptr};
+    vk::Fence             fence{nullptr};
+    bool                  recording{false};
+    std::vector<Buffer>   stagingBuffers;
+    std::vector<uint32_t> pendingDestroys;
+
+    void           create(const TraceRecord& record);
+    void           destroy(uint32_t id);
+    void           upload(const TraceRecord& record, ReplayStats& stats);
+    void           copy(const TraceRecord& record, ReplayStats& stats);
+    void           dispatch(const TraceRecord& record, ReplayStats& stats);
+    void           draw(const TraceRecord& record, ReplayStats& stats);
+    void           flush();
+    void           begin();
+    void           barrier();
+    Compute&       compute(const TraceRecord& record);
+    Graphics&      graphics(const TraceRecord& record);
+    const uint8_t* payload(const TraceRecord& record) const;
+};
+} // namespace vtpl
+
+#endif // trace_replay_h
@@ -0,0 +1,155 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef wall_compositor_h
+#define wall_compositor_h
+#include "engine.h"
+#include "gpu_memory.h"
+#include "tile_viewport.h"
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace vtpl
+{
+/**
+    One tile of a video wall: where it goes and which stream it shows.
+*/
+struct WallTile
+{
+    TileViewport viewport;
+    uint32_t     stream{0};
+};
+
+/**
+    Composites many camera streams into one offscreen render target with a single instanced
+    draw per frame.
+
+    Every stream owns a layer of one array texture, every tile is an instance which picks its
+    layer from the tile table. The layout lives in a storage buffer, so changing it never
+    rebuilds a pipeline. The target is kept between frames and only tiles whose stream got a
+    new frame since the last composite are redrawn; a layout change redraws everything.
+
+    New frames are staged in host visible slices which are handed out in update order and
+    recycled by every composite, so staging memory follows the number of streams which change
+    per frame rather than the number of streams.
+
+    Decoder threads may call update_stream while another thread composites; every public
+    function takes the compositor lock, so an update waits for a running composite and the
+    other way around.
+*/
+class WallCompositor
+{
+  public:
+    /**
+        \param engine the engine to render with, must outlive the compositor
+        \param width width of the render target in pixels
+        \param height height of the render target in pixels
+        \param streamCount number of streams which can be shown
+        \param streamExtent size of the frames of every stream
+        \param stagingSlices number of frames which can be staged between two composites, when
+        more streams change the staged frames are uploaded early
+    */
+    WallCompositor(Engine& engine, uint32_t width, uint32_t height, uint32_t streamCount, vk::Extent2D streamExtent,
+                   uint32_t stagingSlices = 16);
+    ~WallCompositor();
+    WallCompositor(const WallCompositor&) = delete;
+    WallCompositor& operator=(const WallCompositor&) = delete;
+
+    /**
+        Replace the wall layout. Takes effect on the next composite, which redraws every tile.
+
+        \returns false if a tile refers to a stream past the end
+    */
+    bool set_layout(const std::vector<WallTile>& tiles);
+
+    /**
+        Queue a new frame of a stream for upload on the next composite. Blocks on an early
+        upload when all staging slices are taken. A stream's telemetry queue depth is 1 while
+        it has a frame waiting, a frame replacing a waiting one counts as dropped.
+
+        \param stream the stream the frame belongs to
+        \param rgba tightly packed RGBA8 rows of streamExtent size
+        \returns false if the stream is past the end
+    */
+    bool update_stream(uint32_t stream, const uint8_t* rgba);
+
+    /**
+        Upload queued frames and redraw the tiles which changed since the last composite.
+        Blocks until the GPU has finished.
+
+        \returns the number of tiles which were redrawn
+    */
+    uint32_t composite();
+
+    /**
+        \returns the last composited frame as tightly packed RGBA8 rows
+    */
+    std::vector<uint8_t> readback() const;
+
+    const vtpl::Image& get_target() const { return target; }
+
+  private:
+    // std430 layout of a tile, see compositor.vert
+    struct GpuTile
+    {
+        float    rect[4];
+        uint32_t layer;
+        uint32_t unused[3];
+    };
+
+    Engine&      engine;
+    uint32_t     width;
+    uint32_t     height;
+    uint32_t     streamCount;
+    vk::Extent2D streamExtent;
+
+    // guards everything below, the staging slices and the command buffer included
+    mutable std::mutex mutex;
+
+    std::vector<WallTile> tiles;
+    bool                  layoutChanged{true};
+
+    // frame counter of every stream and the counter each tile was last drawn with
+    std::vector<uint64_t> streamFrames;
+    std::vector<uint64_t> tileFrames;
+    std::vector<bool>     pendingUploads;
+
+    // staging slice holding the pending frame of every stream, and the slices handed out
+    std::vector<uint32_t> stagingSlice;
+    uint32_t              stagingSlices;
+    uint32_t              usedSlices{0};
+
+    vtpl::Buffer tileBuffer;
+    vtpl::Buffer drawListBuffer;
+    vtpl::Buffer stagingBuffer;
+    vtpl::Buffer readbackBuffer;
+    vtpl::Image  streamImages;
+    vtpl::Image  target;
+
+    vk::Sampler             sampler{nullptr};
+    vk::DescriptorSetLayout descriptorSetLayout{nullptr};
+    vk::DescriptorPool      descriptorPool{nullptr};
+    vk::DescriptorSet       descriptorSet{nullptr};
+    vk::PipelineLayout      pipelineLayout{nullptr};
+    vk::Pipeline            pipeline{nullptr};
+    vk::RenderPass          renderPass{nullptr};
+    vk::Framebuffer         framebuffer{nullptr};
+    vk::CommandPool         commandPool{nullptr};
+    vk::CommandBuffer       commandBuffer{nullptr};
+    vk::Fence               fence{nullptr};
+
+    void ensure_tile_capacity(size_t count);
+    void write_buffer_descriptors();
+    void make_descriptors();
+    void make_pipeline();
+    void record(const vk::CommandBuffer& cmd, uint32_t drawCount);
+    void record_uploads(const vk::CommandBuffer& cmd);
+    void flush_uploads();
+};
+} // namespace vtpl
+
+#endif // wall_compositor_h
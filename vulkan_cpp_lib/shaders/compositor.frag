@@ -0,0 +1,17 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#version 450
+
+layout(set = 0, binding = 2) uniform sampler2DArray streams;
+
+layout(location = 0) in vec2 inUv;
+layout(location = 1) flat in uint inLayer;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    outColor = vec4(texture(streams, vec3(inUv, float(inLayer))).rgb, 1.0);
+}
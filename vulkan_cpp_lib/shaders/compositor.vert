@@ -0,0 +1,39 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#version 450
+
+// Places one stream layer per instance on the wall. The draw list holds the tiles which
+// need redrawing this frame, the tile table holds the current layout.
+
+struct Tile
+{
+    vec4  rect;  // x, y, width, height in pixels
+    uvec4 misc;  // stream layer, unused
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Tiles { Tile tiles[]; };
+layout(std430, set = 0, binding = 1) readonly buffer DrawList { uint drawList[]; };
+
+layout(push_constant) uniform Params
+{
+    vec2 targetSize;
+} params;
+
+layout(location = 0) out vec2 outUv;
+layout(location = 1) flat out uint outLayer;
+
+const vec2 corners[6] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+                               vec2(0.0, 1.0));
+
+void main()
+{
+    Tile tile = tiles[drawList[gl_InstanceIndex]];
+    vec2 corner = corners[gl_VertexIndex];
+    vec2 position = tile.rect.xy + corner * tile.rect.zw;
+
+    outUv = corner;
+    outLayer = tile.misc.x;
+    gl_Position = vec4(position / params.targetSize * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,91 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+// Block-wise motion detection shared by the subgroup and shared memory variants. Every
+// invocation downscales a 4x4 luma block to one pixel, compares it against the stream's
+// background model and updates the model; every workgroup then reduces its changed pixels
+// with reduce_motion() and adds them to the zone score of its block.
+//
+// Background values are kept in 8.8 fixed point and updated with integer arithmetic only,
+// so the results match MotionDetector's CPU reference exactly.
+
+layout(local_size_x = 16, local_size_y = 8) in;
+
+const uint FLAG_ACTIVE = 1;
+const uint FLAG_INITIALIZE = 2;
+
+layout(std430, set = 0, binding = 0) readonly buffer Luma { uint luma[]; };
+layout(std430, set = 0, binding = 1) buffer Background { uint background[]; };
+layout(std430, set = 0, binding = 2) readonly buffer Flags { uint flags[]; };
+layout(std430, set = 0, binding = 3) buffer Scores { uint scores[]; };
+
+layout(push_constant) uniform Params
+{
+    uint width;
+    uint height;
+    uint downWidth;
+    uint downHeight;
+    uint zonesX;
+    uint zonesY;
+    uint threshold;
+    uint learningDivisor;
+} params;
+
+uint detect_motion(uint stream, uint streamFlags)
+{
+    uvec2 p = gl_GlobalInvocationID.xy;
+    if (p.x >= params.downWidth || p.y >= params.downHeight)
+    {
+        return 0;
+    }
+
+    // four luma bytes per word, four rows per downscaled pixel
+    uint rowWords = params.width / 4;
+    uint base = stream * rowWords * params.height + 4 * p.y * rowWords + p.x;
+    uint sum = 0;
+    for (uint row = 0; row < 4; row++)
+    {
+        uint word = luma[base + row * rowWords];
+        sum += (word & 0xFF) + ((word >> 8) & 0xFF) + ((word >> 16) & 0xFF) + (word >> 24);
+    }
+    int current = int((sum / 16) << 8);
+
+    uint index = stream * params.downWidth * params.downHeight + p.y * params.downWidth + p.x;
+    if ((streamFlags & FLAG_INITIALIZE) != 0)
+    {
+        background[index] = uint(current);
+        return 0;
+    }
+
+    int model = int(background[index]);
+    int difference = abs(current - model) / 256;
+    background[index] = uint(model + (current - model) / int(params.learningDivisor));
+    return difference > int(params.threshold) ? 1 : 0;
+}
+
+uint zone_index(uint stream)
+{
+    uint blocksX = (params.downWidth + gl_WorkGroupSize.x - 1) / gl_WorkGroupSize.x;
+    uint blocksY = (params.downHeight + gl_WorkGroupSize.y - 1) / gl_WorkGroupSize.y;
+    uint zoneX = gl_WorkGroupID.x * params.zonesX / blocksX;
+    uint zoneY = gl_WorkGroupID.y * params.zonesY / blocksY;
+    return stream * params.zonesX * params.zonesY + zoneY * params.zonesX + zoneX;
+}
+
+void main()
+{
+    // one dispatch covers every stream, streams without a new frame drop out as a whole group
+    uint stream = gl_WorkGroupID.z;
+    uint streamFlags = flags[stream];
+    if ((streamFlags & FLAG_ACTIVE) == 0)
+    {
+        return;
+    }
+
+    uint total = reduce_motion(detect_motion(stream, streamFlags));
+    if (gl_LocalInvocationIndex == 0 && total > 0)
+    {
+        atomicAdd(scores[zone_index(stream)], total);
+    }
+}
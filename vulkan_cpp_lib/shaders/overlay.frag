@@ -0,0 +1,79 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#version 450
+
+// Evaluates box outlines and segments analytically and labels from the SDF glyph atlas,
+// clipping everything to the tile the record belongs to. Specialized per primitive kind.
+
+const uint KIND_BOX = 0;
+const uint KIND_SEGMENT = 1;
+const uint KIND_GLYPH = 2;
+
+layout(constant_id = 0) const uint KIND = KIND_BOX;
+
+layout(set = 0, binding = 4) uniform sampler2D glyphAtlas;
+
+layout(push_constant) uniform Params
+{
+    vec2 targetSize;
+    uint capacity;
+    uint unused;
+} params;
+
+layout(location = 0) in vec2 inUv;
+layout(location = 1) flat in vec4 inGeom;
+layout(location = 2) flat in vec4 inClip;
+layout(location = 3) flat in vec4 inColor;
+layout(location = 4) flat in float inThickness;
+
+layout(location = 0) out vec4 outColor;
+
+float box_distance(vec2 p, vec2 lo, vec2 hi)
+{
+    vec2 center = (lo + hi) * 0.5;
+    vec2 q = abs(p - center) - (hi - lo) * 0.5;
+    return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0);
+}
+
+float segment_distance(vec2 p, vec2 a, vec2 b)
+{
+    vec2  pa = p - a;
+    vec2  ba = b - a;
+    float h = clamp(dot(pa, ba) / max(dot(ba, ba), 1e-6), 0.0, 1.0);
+    return length(pa - ba * h);
+}
+
+void main()
+{
+    vec2 p = gl_FragCoord.xy;
+    if (p.x < inClip.x || p.y < inClip.y || p.x >= inClip.z || p.y >= inClip.w)
+    {
+        discard;
+    }
+
+    float coverage;
+    if (KIND == KIND_BOX)
+    {
+        float d = abs(box_distance(p, min(inGeom.xy, inGeom.zw), max(inGeom.xy, inGeom.zw)));
+        coverage = clamp(inThickness * 0.5 - d + 0.5, 0.0, 1.0);
+    }
+    else if (KIND == KIND_SEGMENT)
+    {
+        float d = segment_distance(p, inGeom.xy, inGeom.zw);
+        coverage = clamp(inThickness * 0.5 - d + 0.5, 0.0, 1.0);
+    }
+    else
+    {
+        float d = texture(glyphAtlas, inUv).r;
+        float w = max(fwidth(d), 1e-4);
+        coverage = smoothstep(0.5 - w, 0.5 + w, d);
+    }
+
+    if (coverage <= 0.0)
+    {
+        discard;
+    }
+    outColor = vec4(inColor.rgb, inColor.a * coverage);
+}
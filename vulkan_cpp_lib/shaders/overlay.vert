@@ -0,0 +1,81 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#version 450
+
+// Expands one compacted overlay record into a screen aligned (box, glyph) or segment
+// aligned quad. Six vertices per instance, no vertex buffers. Specialized per primitive
+// kind, so every pipeline variant only keeps the code of its own kind.
+
+const uint KIND_BOX = 0;
+const uint KIND_SEGMENT = 1;
+const uint KIND_GLYPH = 2;
+
+layout(constant_id = 0) const uint KIND = KIND_BOX;
+
+struct Visible
+{
+    vec4  geom;
+    vec4  uv;
+    vec4  clip;
+    uvec4 misc;
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer Visibles { Visible visible[]; };
+
+layout(push_constant) uniform Params
+{
+    vec2 targetSize;
+    uint capacity;
+    uint unused;
+} params;
+
+layout(location = 0) out vec2 outUv;
+layout(location = 1) flat out vec4 outGeom;
+layout(location = 2) flat out vec4 outClip;
+layout(location = 3) flat out vec4 outColor;
+layout(location = 4) flat out float outThickness;
+
+const vec2 corners[6] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+                               vec2(0.0, 1.0));
+
+void main()
+{
+    Visible v = visible[KIND * params.capacity + gl_InstanceIndex];
+    vec2    corner = corners[gl_VertexIndex];
+    float   thickness = uintBitsToFloat(v.misc.y);
+
+    vec2 position;
+    if (KIND == KIND_SEGMENT)
+    {
+        vec2  a = v.geom.xy;
+        vec2  b = v.geom.zw;
+        vec2  delta = b - a;
+        float len = length(delta);
+        vec2  dir = len > 0.0 ? delta / len : vec2(1.0, 0.0);
+        vec2  normal = vec2(-dir.y, dir.x);
+        float pad = thickness * 0.5 + 1.0;
+        vec2  start = a - dir * pad;
+        vec2  end = b + dir * pad;
+        position = mix(start, end, corner.x) + normal * mix(-pad, pad, corner.y);
+    }
+    else if (KIND == KIND_BOX)
+    {
+        float pad = thickness * 0.5 + 1.0;
+        vec2  lo = min(v.geom.xy, v.geom.zw) - pad;
+        vec2  hi = max(v.geom.xy, v.geom.zw) + pad;
+        position = mix(lo, hi, corner);
+    }
+    else
+    {
+        position = mix(v.geom.xy, v.geom.zw, corner);
+    }
+
+    outUv = mix(v.uv.xy, v.uv.zw, corner);
+    outGeom = v.geom;
+    outClip = v.clip;
+    outColor = unpackUnorm4x8(v.misc.x);
+    outThickness = thickness;
+    gl_Position = vec4(position / params.targetSize * 2.0 - 1.0, 0.0, 1.0);
+}
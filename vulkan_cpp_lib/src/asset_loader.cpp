@@ -0,0 +1,307 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "asset_loader.h"
+#include "command_trace.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <logging.h>
+#include <utility>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+namespace vtpl
+{
+AssetLoader::AssetLoader(Engine& engine, size_t threadCount, vk::Format format)
+    : engine(engine), format(format), blitMipmaps(supports_linear_blit(engine.get_physical_device(), format))
+{
+    if (!blitMipmaps && engine.is_debug())
+    {
+        RAY_LOG_INF << "Format " << vk::to_string(format) << " cannot be blitted, assets get no mip chain";
+    }
+    make_placeholder();
+
+    const vk::Device& device = engine.get_device();
+    commandPool = device.createCommandPool(vk::CommandPoolCreateInfo(
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer, engine.get_queue_family_index()));
+    vk::CommandBufferAllocateInfo allocInfo =
+        vk::CommandBufferAllocateInfo(commandPool, vk::CommandBufferLevel::ePrimary, 1);
+    commandBuffer = device.allocateCommandBuffers(allocInfo)[0];
+    fence = device.createFence(vk::FenceCreateInfo());
+
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1U, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        workers.emplace_back(&AssetLoader::run, this);
+    }
+}
+
+AssetLoader::~AssetLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    finish_upload(true);
+    const vk::Device& device = engine.get_device();
+    device.destroyFence(fence);
+    device.destroyCommandPool(commandPool);
+
+    for (Asset& asset : assets)
+    {
+        if (asset.state == AssetState::Ready)
+        {
+            destroy_image(engine, asset.image);
+        }
+    }
+    destroy_image(engine, placeholder);
+}
+
+AssetLoader::Handle AssetLoader::load(const std::string& path)
+{
+    Handle handle = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        handle = static_cast<Handle>(assets.size());
+        assets.push_back(Asset{path});
+        queued.push_back(handle);
+    }
+    wakeup.notify_one();
+    return handle;
+}
+
+size_t AssetLoader::update(vk::DeviceSize maxBytes)
+{
+    const size_t ready = finish_upload(false);
+    if (!inFlight)
+    {
+        start_upload(maxBytes);
+    }
+    return ready;
+}
+
+Image AssetLoader::texture(Handle handle) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (handle < assets.size() && assets[handle].state == AssetState::Ready)
+    {
+        return assets[handle].image;
+    }
+    return placeholder;
+}
+
+AssetState AssetLoader::state(Handle handle) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return handle < assets.size() ? assets[handle].state : AssetState::Failed;
+}
+
+size_t AssetLoader::pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<size_t>(std::count_if(assets.begin(), assets.end(),
+                                             [](const Asset& asset)
+                                             {
+                                                 return asset.state == AssetState::Decoding ||
+                                                        asset.state == AssetState::Decoded;
+                                             }));
+}
+
+void AssetLoader::start_upload(vk::DeviceSize maxBytes)
+{
+    // take the decoded assets out under the lock, the upload is set up without it
+    std::vector<vk::Extent2D>                   extents;
+    std::vector<std::shared_ptr<const uint8_t>> pixels;
+    vk::DeviceSize                              total = 0;
+    Upload                                      upload;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t                      taken = 0;
+        for (; taken < decoded.size(); taken++)
+        {
+            const Asset&         asset = assets[decoded[taken]];
+            const vk::DeviceSize bytes = vk::DeviceSize(asset.extent.width) * asset.extent.height * 4;
+            if (taken > 0 && total + bytes > maxBytes)
+            {
+                break;
+            }
+            upload.batch.push_back(decoded[taken]);
+            extents.push_back(asset.extent);
+            pixels.push_back(asset.pixels);
+            total += bytes;
+        }
+        decoded.erase(decoded.begin(), decoded.begin() + static_cast<std::ptrdiff_t>(taken));
+    }
+    if (upload.batch.empty())
+    {
+        return;
+    }
+
+    try
+    {
+        upload.staging =
+            make_buffer(engine, total, vk::BufferUsageFlagBits::eTransferSrc,
+                        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+        std::vector<vk::DeviceSize> offsets;
+        vk::DeviceSize              offset = 0;
+        for (size_t i = 0; i < upload.batch.size(); i++)
+        {
+            const vk::DeviceSize bytes = vk::DeviceSize(extents[i].width) * extents[i].height * 4;
+            std::memcpy(static_cast<uint8_t*>(upload.staging.mapped) + offset, pixels[i].get(),
+                        static_cast<size_t>(bytes));
+            offsets.push_back(offset);
+            offset += bytes;
+
+            const uint32_t mipLevels = blitMipmaps ? mip_level_count(extents[i]) : 1;
+            upload.images.push_back(make_image(engine, extents[i], format,
+                                               vk::ImageUsageFlagBits::eTransferSrc |
+                                                   vk::ImageUsageFlagBits::eTransferDst |
+                                                   vk::ImageUsageFlagBits::eSampled,
+                                               mipLevels));
+        }
+
+        commandBuffer.reset();
+        commandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        for (size_t i = 0; i < upload.images.size(); i++)
+        {
+            const Image& image = upload.images[i];
+            transition_image(commandBuffer, image, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+            vk::BufferImageCopy region = vk::BufferImageCopy(
+                offsets[i], 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+                vk::Offset3D(0, 0, 0), vk::Extent3D(extents[i].width, extents[i].height, 1));
+            commandBuffer.copyBufferToImage(upload.staging.buffer, image.image, vk::ImageLayout::eTransferDstOptimal,
+                                            region);
+            generate_mipmaps(commandBuffer, image);
+        }
+        commandBuffer.end();
+
+        vk::SubmitInfo submitInfo = vk::SubmitInfo(0, nullptr, nullptr, 1, &commandBuffer);
+        engine.submit(submitInfo, fence);
+    }
+    catch (const std::exception& e)
+    {
+        // nothing reached the GPU, so everything made so far can go right away
+        RAY_LOG_ERR << "Failed to upload " << upload.batch.size() << " assets: " << e.what();
+        for (Image& image : upload.images)
+        {
+            destroy_image(engine, image);
+        }
+        if (upload.staging.buffer)
+        {
+            destroy_buffer(engine, upload.staging);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Handle handle : upload.batch)
+        {
+            assets[handle].pixels.reset();
+            assets[handle].state = AssetState::Failed;
+        }
+        return;
+    }
+
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        for (size_t i = 0; i < upload.images.size(); i++)
+        {
+            trace->upload(upload.images[i].image, pixels[i].get(),
+                          vk::DeviceSize(extents[i].width) * extents[i].height * 4);
+        }
+    }
+    inFlight = std::move(upload);
+}
+
+size_t AssetLoader::finish_upload(bool wait)
+{
+    if (!inFlight)
+    {
+        return 0;
+    }
+    const vk::Device& device = engine.get_device();
+    if (wait)
+    {
+        (void)device.waitForFences(fence, VK_TRUE, UINT64_MAX);
+    }
+    else if (device.getFenceStatus(fence) != vk::Result::eSuccess)
+    {
+        return 0;
+    }
+    device.resetFences(fence);
+    destroy_buffer(engine, inFlight->staging);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < inFlight->batch.size(); i++)
+    {
+        Asset& asset = assets[inFlight->batch[i]];
+        asset.image = inFlight->images[i];
+        asset.pixels.reset();
+        asset.state = AssetState::Ready;
+    }
+    const size_t ready = inFlight->batch.size();
+    inFlight.reset();
+    return ready;
+}
+
+void AssetLoader::make_placeholder()
+{
+    // mid grey reads as "not loaded yet" on maps and icons alike, and needs no mip chain
+    const uint8_t texel[4] = {128, 128, 128, 255};
+    placeholder = make_image(engine, vk::Extent2D(1, 1), format,
+                             vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
+    upload_image(engine, placeholder, texel, sizeof(texel));
+}
+
+void AssetLoader::decode(Handle handle, const std::string& path)
+{
+    int      width = 0;
+    int      height = 0;
+    int      channels = 0;
+    stbi_uc* data = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Asset&                      asset = assets[handle];
+    if (data == nullptr)
+    {
+        RAY_LOG_ERR << "Failed to decode \"" << path << "\": " << stbi_failure_reason();
+        asset.state = AssetState::Failed;
+        return;
+    }
+    asset.extent = vk::Extent2D(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+    asset.pixels = std::shared_ptr<const uint8_t>(data, [](const uint8_t* pixels)
+                                                  { stbi_image_free(const_cast<uint8_t*>(pixels)); });
+    asset.state = AssetState::Decoded;
+    decoded.push_back(handle);
+}
+
+void AssetLoader::run()
+{
+    for (;;)
+    {
+        Handle      handle = 0;
+        std::string path;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [this] { return stopping || !queued.empty(); });
+            if (stopping)
+            {
+                return;
+            }
+            handle = queued.front();
+            queued.pop_front();
+            path = assets[handle].path;
+        }
+        decode(handle, path);
+    }
+}
+} // namespace vtpl
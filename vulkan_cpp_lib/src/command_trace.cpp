@@ -0,0 +1,456 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "command_trace.h"
+#include <algorithm>
+#include <cstring>
+#include <logging.h>
+#include <stdexcept>
+
+namespace vtpl
+{
+namespace
+{
+constexpr char magic[4] = {'V', 'T', 'R', 'C'};
+
+template <typename Handle> uint64_t handle_key(Handle handle)
+{
+    // non-dispatchable handles are pointers on 64 bit platforms and integers elsewhere
+    return reinterpret_cast<uint64_t>(static_cast<typename Handle::CType>(handle));
+}
+
+uint32_t find_id(const std::unordered_map<uint64_t, uint32_t>& ids, uint64_t handle)
+{
+    auto found = ids.find(handle);
+    return found == ids.end() ? 0 : found->second;
+}
+} // namespace
+
+uint64_t payload_hash(const void* data, size_t size)
+{
+    // FNV-1a over 8 byte words, with the tail folded in bytewise
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    uint64_t    hash = 14695981039346656037ULL ^ size;
+    size_t      i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word = 0;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ULL;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+CommandTrace::CommandTrace(const std::string& path, bool hashPayloads)
+    : out(path, std::ios::binary | std::ios::trunc), hashPayloads(hashPayloads)
+{
+    if (!out)
+    {
+        throw std::runtime_error("Failed to open command trace \"" + path + "\"");
+    }
+    out.write(magic, sizeof(magic));
+    put(version);
+}
+
+CommandTrace::~CommandTrace()
+{
+    out.flush();
+    if (!out)
+    {
+        RAY_LOG_ERR << "Command trace was not completely written";
+    }
+}
+
+void CommandTrace::create_buffer(vk::Buffer buffer, vk::DeviceSize size, vk::BufferUsageFlags usage,
+                                 vk::MemoryPropertyFlags properties)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint32_t              id = nextId++;
+    bufferIds[handle_key(buffer)] = id;
+
+    put(TraceOp::CreateBuffer);
+    put(id);
+    put(static_cast<uint64_t>(size));
+    put(static_cast<uint32_t>(usage));
+    put(static_cast<uint32_t>(properties));
+}
+
+void CommandTrace::create_image(const Image& image, vk::ImageUsageFlags usage)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint32_t              id = nextId++;
+    imageIds[handle_key(image.image)] = id;
+
+    put(TraceOp::CreateImage);
+    put(id);
+    put(image.extent.width);
+    put(image.extent.height);
+    put(static_cast<uint32_t>(image.format));
+    put(static_cast<uint32_t>(usage));
+    put(image.mipLevels);
+    put(image.arrayLayers);
+}
+
+void CommandTrace::destroy(vk::Buffer buffer)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    write_destroy(bufferIds, handle_key(buffer));
+}
+
+void CommandTrace::destroy(vk::Image image)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    write_destroy(imageIds, handle_key(image));
+}
+
+void CommandTrace::upload(vk::Buffer buffer, vk::DeviceSize offset, const void* data, vk::DeviceSize size,
+                          bool store)
+{
+    // hashing is the expensive part, so it is done before taking the lock
+    const uint64_t              hash = hashPayloads ? payload_hash(data, static_cast<size_t>(size)) : 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint32_t              id = find_id(bufferIds, handle_key(buffer));
+    if (id != 0)
+    {
+        write_upload(id, offset, data, size, hash, store);
+    }
+}
+
+void CommandTrace::upload(vk::Image image, const void* data, vk::DeviceSize size)
+{
+    const uint64_t              hash = hashPayloads ? payload_hash(data, static_cast<size_t>(size)) : 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint32_t              id = find_id(imageIds, handle_key(image));
+    if (id != 0)
+    {
+        write_upload(id, 0, data, size, hash, false);
+    }
+}
+
+void CommandTrace::begin(vk::CommandBuffer commandBuffer)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    commands(commandBuffer).clear();
+}
+
+void CommandTrace::copy(vk::CommandBuffer commandBuffer, vk::Buffer buffer, vk::Image image,
+                        vk::ArrayProxy<const vk::BufferImageCopy> regions)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string&                bytes = commands(commandBuffer);
+
+    append(bytes, TraceOp::CopyToImage);
+    // 0 marks a resource created before the trace, the replay skips such copies
+    append(bytes, find_id(bufferIds, handle_key(buffer)));
+    append(bytes, find_id(imageIds, handle_key(image)));
+    append(bytes, static_cast<uint32_t>(regions.size()));
+    for (const vk::BufferImageCopy& region : regions)
+    {
+        append(bytes, static_cast<uint64_t>(region.bufferOffset));
+        append(bytes, region.imageSubresource.mipLevel);
+        append(bytes, region.imageSubresource.baseArrayLayer);
+        append(bytes, region.imageSubresource.layerCount);
+        append(bytes, region.imageOffset.x);
+        append(bytes, region.imageOffset.y);
+        append(bytes, region.imageExtent.width);
+        append(bytes, region.imageExtent.height);
+    }
+}
+
+void CommandTrace::dispatch(vk::CommandBuffer commandBuffer, const std::string& shader,
+                            vk::ArrayProxy<const vk::Buffer> bindings, const void* pushConstants, uint32_t pushSize,
+                            uint32_t x, uint32_t y, uint32_t z)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string&                bytes = commands(commandBuffer);
+
+    append(bytes, TraceOp::Dispatch);
+    append_string(bytes, shader);
+    write_bindings(bytes, bindings);
+    append(bytes, static_cast<uint16_t>(pushSize));
+    append(bytes, pushConstants, pushSize);
+    append(bytes, x);
+    append(bytes, y);
+    append(bytes, z);
+}
+
+void CommandTrace::draw(vk::CommandBuffer commandBuffer, const std::string& vertexShader,
+                        const std::string& fragmentShader, const Image& target,
+                        vk::ArrayProxy<const vk::Buffer> bindings, vk::Image sampled, const void* pushConstants,
+                        uint32_t pushSize, uint32_t vertexCount, uint32_t instanceCount)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string&                bytes = commands(commandBuffer);
+
+    append(bytes, TraceOp::Draw);
+    append_string(bytes, vertexShader);
+    append_string(bytes, fragmentShader);
+    append(bytes, find_id(imageIds, handle_key(target.image)));
+    append(bytes, static_cast<uint32_t>(target.format));
+    append(bytes, target.extent.width);
+    append(bytes, target.extent.height);
+    write_bindings(bytes, bindings);
+    append(bytes, find_id(imageIds, handle_key(sampled)));
+    append(bytes, static_cast<uint16_t>(pushSize));
+    append(bytes, pushConstants, pushSize);
+    append(bytes, vertexCount);
+    append(bytes, instanceCount);
+}
+
+void CommandTrace::submit(vk::ArrayProxy<const vk::SubmitInfo> submitInfos)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t                    commandBufferCount = 0;
+    for (const vk::SubmitInfo& submitInfo : submitInfos)
+    {
+        for (uint32_t i = 0; i < submitInfo.commandBufferCount; i++)
+        {
+            // the commands stay recorded, a command buffer submitted again runs them again
+            auto found = recorded.find(handle_key(submitInfo.pCommandBuffers[i]));
+            if (found != recorded.end())
+            {
+                out.write(found->second.data(), static_cast<std::streamsize>(found->second.size()));
+            }
+        }
+        commandBufferCount += submitInfo.commandBufferCount;
+    }
+    put(TraceOp::Submit);
+    put(commandBufferCount);
+}
+
+void CommandTrace::frame()
+{
+    const auto elapsed =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    std::lock_guard<std::mutex> lock(mutex);
+    put(TraceOp::Frame);
+    put(static_cast<uint64_t>(elapsed.count()));
+}
+
+std::string& CommandTrace::commands(vk::CommandBuffer commandBuffer)
+{
+    return recorded[handle_key(commandBuffer)];
+}
+
+void CommandTrace::write_destroy(std::unordered_map<uint64_t, uint32_t>& ids, uint64_t handle)
+{
+    auto found = ids.find(handle);
+    if (found == ids.end())
+    {
+        return;
+    }
+    put(TraceOp::Destroy);
+    put(found->second);
+    ids.erase(found);
+}
+
+void CommandTrace::write_upload(uint32_t id, uint64_t offset, const void* data, uint64_t size, uint64_t hash,
+                                bool store)
+{
+    const bool stored = store || size <= inlineLimit;
+    put(TraceOp::Upload);
+    put(id);
+    put(offset);
+    put(size);
+    put(hash);
+    put(static_cast<uint8_t>(stored));
+    if (stored)
+    {
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    }
+}
+
+void CommandTrace::write_bindings(std::string& bytes, vk::ArrayProxy<const vk::Buffer> bindings)
+{
+    append(bytes, static_cast<uint8_t>(bindings.size()));
+    for (const vk::Buffer& buffer : bindings)
+    {
+        // 0 marks a buffer created before the trace, the replay skips commands using it
+        append(bytes, find_id(bufferIds, handle_key(buffer)));
+    }
+}
+
+void CommandTrace::append(std::string& bytes, const void* data, size_t size)
+{
+    bytes.append(static_cast<const char*>(data), size);
+}
+
+void CommandTrace::append_string(std::string& bytes, const std::string& value)
+{
+    append(bytes, static_cast<uint16_t>(value.size()));
+    bytes.append(value);
+}
+
+TraceReader::TraceReader(const std::string& path) : in(path, std::ios::binary | std::ios::ate)
+{
+    fileSize = in ? static_cast<uint64_t>(in.tellg()) : 0;
+    in.seekg(0);
+    char header[sizeof(magic)] = {};
+    in.read(header, sizeof(header));
+    const auto fileVersion = get<uint32_t>();
+    if (!in || std::memcmp(header, magic, sizeof(magic)) != 0)
+    {
+        throw std::runtime_error("\"" + path + "\" is not a command trace");
+    }
+    if (fileVersion == 0 || fileVersion > CommandTrace::version)
+    {
+        throw std::runtime_error("Command trace \"" + path + "\" has unsupported version " +
+                                 std::to_string(fileVersion));
+    }
+}
+
+bool TraceReader::next(TraceRecord& record)
+{
+    if (in.peek() == std::ifstream::traits_type::eof())
+    {
+        return false;
+    }
+    record = TraceRecord();
+    record.op = get<TraceOp>();
+    switch (record.op)
+    {
+    case TraceOp::CreateBuffer:
+        record.id = get<uint32_t>();
+        record.size = get<uint64_t>();
+        record.usage = get<uint32_t>();
+        record.properties = get<uint32_t>();
+        break;
+    case TraceOp::CreateImage:
+        record.id = get<uint32_t>();
+        record.extent.width = get<uint32_t>();
+        record.extent.height = get<uint32_t>();
+        record.format = static_cast<vk::Format>(get<uint32_t>());
+        record.usage = get<uint32_t>();
+        record.mipLevels = get<uint32_t>();
+        record.arrayLayers = get<uint32_t>();
+        break;
+    case TraceOp::Destroy:
+        record.id = get<uint32_t>();
+        break;
+    case TraceOp::Upload:
+        record.id = get<uint32_t>();
+        record.offset = get<uint64_t>();
+        record.size = get<uint64_t>();
+        record.hash = get<uint64_t>();
+        if (get<uint8_t>() != 0)
+        {
+            check_remaining(record.size, 1);
+            record.data.resize(static_cast<size_t>(record.size));
+            in.read(reinterpret_cast<char*>(record.data.data()), static_cast<std::streamsize>(record.size));
+        }
+        break;
+    case TraceOp::Dispatch:
+    {
+        record.shader = read_string();
+        read_bindings(record.bindings);
+        record.pushConstants.resize(get<uint16_t>());
+        check_remaining(record.pushConstants.size(), 1);
+        in.read(reinterpret_cast<char*>(record.pushConstants.data()),
+                static_cast<std::streamsize>(record.pushConstants.size()));
+        for (uint32_t& groups : record.groups)
+        {
+            groups = get<uint32_t>();
+        }
+        break;
+    }
+    case TraceOp::Submit:
+        record.commandBufferCount = get<uint32_t>();
+        break;
+    case TraceOp::Frame:
+        record.time = std::chrono::nanoseconds(get<uint64_t>());
+        break;
+    case TraceOp::CopyToImage:
+    {
+        record.id = get<uint32_t>();
+        record.target = get<uint32_t>();
+        const auto regionCount = get<uint32_t>();
+        // offset, then mip level, base layer, layer count, x, y, width and height
+        check_remaining(regionCount, sizeof(uint64_t) + 7 * sizeof(uint32_t));
+        record.regions.resize(regionCount);
+        for (vk::BufferImageCopy& region : record.regions)
+        {
+            region.bufferOffset = get<uint64_t>();
+            region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+            region.imageSubresource.mipLevel = get<uint32_t>();
+            region.imageSubresource.baseArrayLayer = get<uint32_t>();
+            region.imageSubresource.layerCount = get<uint32_t>();
+            region.imageOffset.x = get<int32_t>();
+            region.imageOffset.y = get<int32_t>();
+            region.imageExtent.width = get<uint32_t>();
+            region.imageExtent.height = get<uint32_t>();
+            region.imageExtent.depth = 1;
+        }
+        break;
+    }
+    case TraceOp::Draw:
+    {
+        record.shader = read_string();
+        record.fragmentShader = read_string();
+        record.target = get<uint32_t>();
+        record.format = static_cast<vk::Format>(get<uint32_t>());
+        record.extent.width = get<uint32_t>();
+        record.extent.height = get<uint32_t>();
+        read_bindings(record.bindings);
+        record.sampled = get<uint32_t>();
+        record.pushConstants.resize(get<uint16_t>());
+        check_remaining(record.pushConstants.size(), 1);
+        in.read(reinterpret_cast<char*>(record.pushConstants.data()),
+                static_cast<std::streamsize>(record.pushConstants.size()));
+        record.vertexCount = get<uint32_t>();
+        record.instanceCount = get<uint32_t>();
+        break;
+    }
+    default:
+        throw std::runtime_error("Command trace has an unknown record " +
+                                 std::to_string(static_cast<uint32_t>(record.op)));
+    }
+    if (!in)
+    {
+        throw std::runtime_error("Command trace ends in the middle of a record");
+    }
+    return true;
+}
+
+std::string TraceReader::read_string()
+{
+    const auto size = get<uint16_t>();
+    check_remaining(size, 1);
+    std::string value(size, '\0');
+    in.read(value.data(), static_cast<std::streamsize>(value.size()));
+    return value;
+}
+
+void TraceReader::read_bindings(std::vector<uint32_t>& bindings)
+{
+    const auto count = get<uint8_t>();
+    check_remaining(count, sizeof(uint32_t));
+    bindings.resize(count);
+    for (uint32_t& binding : bindings)
+    {
+        binding = get<uint32_t>();
+    }
+}
+
+void TraceReader::check_remaining(uint64_t count, uint64_t itemSize)
+{
+    const std::streamoff position = in.tellg();
+    if (!in || position < 0)
+    {
+        throw std::runtime_error("Command trace ends in the middle of a record");
+    }
+    const uint64_t remaining = fileSize - std::min(fileSize, static_cast<uint64_t>(position));
+    // dividing avoids the overflow of count * itemSize for a corrupt count
+    if (count > remaining / itemSize)
+    {
+        throw std::runtime_error("Command trace record claims " + std::to_string(count) + " items of " +
+                                 std::to_string(itemSize) + " bytes with " + std::to_string(remaining) +
+                                 " bytes left");
+    }
+}
+} // namespace vtpl
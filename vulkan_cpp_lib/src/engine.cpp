@@ -3,29 +3,45 @@
 // *****************************************************
 
 #include "engine.h"
+#include "command_trace.h"
 #include "core_context.h"
 #include "device.h"
 #include "instance.h"
 #include "vulkan_logging.h"
+#include <algorithm>
+#include <cstring>
 #include <logging.h>
+#include <optional>
+#include <vector>
 #include <vulkan/vulkan.hpp>
 #include <vulkan/vulkan_core.h>
 
-Engine::Engine()
+Engine::Engine(const std::vector<const char*>& windowExtensions)
 {
     vtpl::CoreContext::instance();
     if (debugMode)
     {
         RAY_LOG_INF << "Making a graphics engine";
     }
-    make_instance();
+    make_instance(windowExtensions);
     make_device();
+    make_command_pool();
 }
 Engine::~Engine()
 {
     if (debugMode)
     {
         RAY_LOG_INF << "Removing the graphics engine";
+    }
+    if (device)
+    {
+        device.waitIdle();
+        device.destroyFence(immediateFence);
+        device.destroyCommandPool(commandPool);
+        device.destroy();
+    }
+    if (debugMode)
+    {
         instance.destroyDebugUtilsMessengerEXT(debugMessenger, nullptr, dldi);
     }
     /*
@@ -59,9 +75,29 @@ Engine::~Engine()
     We will look at this later, once we've created an instance and device.
 */
 
-void Engine::make_instance()
+void Engine::make_instance(const std::vector<const char*>& windowExtensions)
 {
-    instance = vtpl::make_instance(debugMode, "ID Tech 12");
+    std::vector<const char*> extensions(windowExtensions.begin(), windowExtensions.end());
+
+    /*
+     * A headless surface lets presentation run without a display, e.g. on CI with a
+     * software ICD. It is an optional extra, never a requirement.
+     */
+    headlessSurfaceSupported = vtpl::instance_extension_available(VK_KHR_SURFACE_EXTENSION_NAME) &&
+                               vtpl::instance_extension_available(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+    if (headlessSurfaceSupported)
+    {
+        const bool hasSurface =
+            std::any_of(extensions.begin(), extensions.end(), [](const char* extension)
+                        { return std::strcmp(extension, VK_KHR_SURFACE_EXTENSION_NAME) == 0; });
+        if (!hasSurface)
+        {
+            extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+        }
+        extensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+    }
+
+    instance = vtpl::make_instance(debugMode, "ID Tech 12", extensions);
     dldi = vk::DispatchLoaderDynamic(instance, vkGetInstanceProcAddr);
     if (debugMode)
     {
@@ -69,4 +105,82 @@ void Engine::make_instance()
     }
 }
 
-void Engine::make_device() { physicalDevice = vtpl::choose_physical_device(instance, debugMode); }
\ No newline at end of file
+void Engine::make_device()
+{
+    physicalDevice = vtpl::choose_physical_device(instance, debugMode);
+    if (!physicalDevice)
+    {
+        RAY_LOG_ERR << "No suitable physical device found!";
+        return;
+    }
+    std::optional<uint32_t> family = vtpl::find_queue_family(physicalDevice, debugMode);
+    if (!family.has_value())
+    {
+        RAY_LOG_ERR << "No graphics and compute capable queue family found!";
+        return;
+    }
+    queueFamilyIndex = family.value();
+
+    // device selection already made sure the swapchain extension is there
+    std::vector<const char*> extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    memoryBudgetSupported = vtpl::supports_memory_budget(physicalDevice, debugMode);
+    if (memoryBudgetSupported)
+    {
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+    device = vtpl::make_logical_device(physicalDevice, queueFamilyIndex, extensions, debugMode);
+    if (device)
+    {
+        queue = device.getQueue(queueFamilyIndex, 0);
+    }
+}
+
+void Engine::make_command_pool()
+{
+    if (!device)
+    {
+        return;
+    }
+    /*
+     * Command buffers allocated from this pool are re-recorded every frame by the
+     * renderers, so they must be individually resettable.
+     */
+    vk::CommandPoolCreateInfo poolInfo =
+        vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueFamilyIndex);
+    commandPool = device.createCommandPool(poolInfo);
+    immediateFence = device.createFence(vk::FenceCreateInfo());
+}
+
+void Engine::submit(vk::ArrayProxy<const vk::SubmitInfo> submitInfos, vk::Fence fence)
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    queue.submit(submitInfos, fence);
+    if (const std::shared_ptr<vtpl::CommandTrace> commandTrace = get_trace())
+    {
+        commandTrace->submit(submitInfos);
+    }
+}
+
+vk::Result Engine::present(const vk::PresentInfoKHR& presentInfo)
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return queue.presentKHR(presentInfo);
+}
+
+void Engine::immediate_submit(const std::function<void(vk::CommandBuffer)>& record)
+{
+    std::lock_guard<std::mutex>   lock(immediateMutex);
+    vk::CommandBufferAllocateInfo allocInfo =
+        vk::CommandBufferAllocateInfo(commandPool, vk::CommandBufferLevel::ePrimary, 1);
+    vk::CommandBuffer commandBuffer = device.allocateCommandBuffers(allocInfo)[0];
+
+    commandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    record(commandBuffer);
+    commandBuffer.end();
+
+    vk::SubmitInfo submitInfo = vk::SubmitInfo(0, nullptr, nullptr, 1, &commandBuffer);
+    submit(submitInfo, immediateFence);
+    (void)device.waitForFences(immediateFence, VK_TRUE, UINT64_MAX);
+    device.resetFences(immediateFence);
+    device.freeCommandBuffers(commandPool, commandBuffer);
+}
\ No newline at end of file
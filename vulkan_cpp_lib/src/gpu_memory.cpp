@@ -0,0 +1,298 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "gpu_memory.h"
+#include "command_trace.h"
+#include "engine.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace vtpl
+{
+uint32_t find_memory_type(const vk::PhysicalDevice& physicalDevice, uint32_t typeFilter,
+                          vk::MemoryPropertyFlags properties)
+{
+    vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    {
+        const bool allowed = (typeFilter & (1U << i)) != 0;
+        const bool matches = (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties;
+        if (allowed && matches)
+        {
+            return i;
+        }
+    }
+    throw std::runtime_error("Failed to find a suitable memory type!");
+}
+
+Buffer make_buffer(const Engine& engine, vk::DeviceSize size, vk::BufferUsageFlags usage,
+                   vk::MemoryPropertyFlags properties)
+{
+    const vk::Device& device = engine.get_device();
+
+    Buffer buffer;
+    buffer.size = size;
+
+    vk::BufferCreateInfo bufferInfo =
+        vk::BufferCreateInfo(vk::BufferCreateFlags(), size, usage, vk::SharingMode::eExclusive);
+    buffer.buffer = device.createBuffer(bufferInfo);
+
+    try
+    {
+        vk::MemoryRequirements requirements = device.getBufferMemoryRequirements(buffer.buffer);
+        vk::MemoryAllocateInfo allocInfo = vk::MemoryAllocateInfo(
+            requirements.size,
+            find_memory_type(engine.get_physical_device(), requirements.memoryTypeBits, properties));
+        buffer.memory = device.allocateMemory(allocInfo);
+        device.bindBufferMemory(buffer.buffer, buffer.memory, 0);
+
+        if (properties & vk::MemoryPropertyFlagBits::eHostVisible)
+        {
+            buffer.mapped = device.mapMemory(buffer.memory, 0, size);
+        }
+    }
+    catch (...)
+    {
+        // callers such as the residency cache retry after an out of memory error, so
+        // nothing may be left behind
+        device.destroyBuffer(buffer.buffer);
+        device.freeMemory(buffer.memory);
+        throw;
+    }
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        trace->create_buffer(buffer.buffer, size, usage, properties);
+    }
+    return buffer;
+}
+
+void destroy_buffer(const Engine& engine, Buffer& buffer)
+{
+    const vk::Device& device = engine.get_device();
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        trace->destroy(buffer.buffer);
+    }
+    if (buffer.mapped != nullptr)
+    {
+        device.unmapMemory(buffer.memory);
+    }
+    device.destroyBuffer(buffer.buffer);
+    device.freeMemory(buffer.memory);
+    buffer = Buffer();
+}
+
+vk::MemoryRequirements buffer_requirements(const Engine& engine, vk::DeviceSize size, vk::BufferUsageFlags usage)
+{
+    const vk::Device&    device = engine.get_device();
+    vk::BufferCreateInfo bufferInfo =
+        vk::BufferCreateInfo(vk::BufferCreateFlags(), size, usage, vk::SharingMode::eExclusive);
+    vk::Buffer             buffer = device.createBuffer(bufferInfo);
+    vk::MemoryRequirements requirements = device.getBufferMemoryRequirements(buffer);
+    device.destroyBuffer(buffer);
+    return requirements;
+}
+
+namespace
+{
+vk::ImageCreateInfo image_create_info(vk::Extent2D extent, vk::Format format, vk::ImageUsageFlags usage,
+                                      uint32_t mipLevels, uint32_t arrayLayers)
+{
+    return vk::ImageCreateInfo(vk::ImageCreateFlags(), vk::ImageType::e2D, format,
+                               vk::Extent3D(extent.width, extent.height, 1), mipLevels, arrayLayers,
+                               vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, usage,
+                               vk::SharingMode::eExclusive, 0, nullptr, vk::ImageLayout::eUndefined);
+}
+
+Image allocate_image(const Engine& engine, vk::Extent2D extent, vk::Format format, vk::ImageUsageFlags usage,
+                     uint32_t mipLevels, uint32_t arrayLayers, vk::ImageViewType viewType)
+{
+    const vk::Device& device = engine.get_device();
+
+    Image image;
+    image.format = format;
+    image.extent = extent;
+    image.mipLevels = mipLevels;
+    image.arrayLayers = arrayLayers;
+
+    image.image = device.createImage(image_create_info(extent, format, usage, mipLevels, arrayLayers));
+
+    try
+    {
+        vk::MemoryRequirements requirements = device.getImageMemoryRequirements(image.image);
+        vk::MemoryAllocateInfo allocInfo =
+            vk::MemoryAllocateInfo(requirements.size, find_memory_type(engine.get_physical_device(),
+                                                                       requirements.memoryTypeBits,
+                                                                       vk::MemoryPropertyFlagBits::eDeviceLocal));
+        image.memory = device.allocateMemory(allocInfo);
+        device.bindImageMemory(image.image, image.memory, 0);
+
+        vk::ImageViewCreateInfo viewInfo = vk::ImageViewCreateInfo(
+            vk::ImageViewCreateFlags(), image.image, viewType, format, vk::ComponentMapping(),
+            vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, arrayLayers));
+        image.view = device.createImageView(viewInfo);
+    }
+    catch (...)
+    {
+        device.destroyImage(image.image);
+        device.freeMemory(image.memory);
+        throw;
+    }
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        trace->create_image(image, usage);
+    }
+    return image;
+}
+} // namespace
+
+vk::MemoryRequirements image_requirements(const Engine& engine, vk::Extent2D extent, vk::Format format,
+                                          vk::ImageUsageFlags usage, uint32_t mipLevels, uint32_t arrayLayers)
+{
+    // creating an image without memory is cheap, and the only portable way to ask on Vulkan 1.1
+    const vk::Device&      device = engine.get_device();
+    vk::Image              image = device.createImage(image_create_info(extent, format, usage, mipLevels, arrayLayers));
+    vk::MemoryRequirements requirements = device.getImageMemoryRequirements(image);
+    device.destroyImage(image);
+    return requirements;
+}
+
+Image make_image(const Engine& engine, vk::Extent2D extent, vk::Format format, vk::ImageUsageFlags usage,
+                 uint32_t mipLevels)
+{
+    return allocate_image(engine, extent, format, usage, mipLevels, 1, vk::ImageViewType::e2D);
+}
+
+Image make_image_array(const Engine& engine, vk::Extent2D extent, vk::Format format, vk::ImageUsageFlags usage,
+                       uint32_t arrayLayers)
+{
+    return allocate_image(engine, extent, format, usage, 1, arrayLayers, vk::ImageViewType::e2DArray);
+}
+
+void destroy_image(const Engine& engine, Image& image)
+{
+    const vk::Device& device = engine.get_device();
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        trace->destroy(image.image);
+    }
+    device.destroyImageView(image.view);
+    device.destroyImage(image.image);
+    device.freeMemory(image.memory);
+    image = Image();
+}
+
+void transition_image(const vk::CommandBuffer& commandBuffer, const Image& image, vk::ImageLayout oldLayout,
+                      vk::ImageLayout newLayout)
+{
+    /*
+     * A full barrier is good enough for the handful of transitions done at resource
+     * creation and readback time; hot paths record their own narrow barriers.
+     */
+    vk::ImageMemoryBarrier barrier = vk::ImageMemoryBarrier(
+        vk::AccessFlagBits::eMemoryWrite, vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite,
+        oldLayout, newLayout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image.image,
+        vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, image.mipLevels, 0, image.arrayLayers));
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eAllCommands,
+                                  vk::DependencyFlags(), nullptr, nullptr, barrier);
+}
+
+void generate_mipmaps(const vk::CommandBuffer& commandBuffer, const Image& image)
+{
+    int32_t width = static_cast<int32_t>(image.extent.width);
+    int32_t height = static_cast<int32_t>(image.extent.height);
+
+    for (uint32_t level = 1; level < image.mipLevels; level++)
+    {
+        // the previous level has been written, read from it for the blit
+        vk::ImageMemoryBarrier toSource = vk::ImageMemoryBarrier(
+            vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferRead,
+            vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eTransferSrcOptimal, VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED, image.image,
+            vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, level - 1, 1, 0, image.arrayLayers));
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+                                      vk::DependencyFlags(), nullptr, nullptr, toSource);
+
+        const int32_t nextWidth = width > 1 ? width / 2 : 1;
+        const int32_t nextHeight = height > 1 ? height / 2 : 1;
+        vk::ImageBlit blit;
+        blit.srcSubresource =
+            vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level - 1, 0, image.arrayLayers);
+        blit.srcOffsets[1] = vk::Offset3D(width, height, 1);
+        blit.dstSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, image.arrayLayers);
+        blit.dstOffsets[1] = vk::Offset3D(nextWidth, nextHeight, 1);
+        commandBuffer.blitImage(image.image, vk::ImageLayout::eTransferSrcOptimal, image.image,
+                                vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+
+        vk::ImageMemoryBarrier toShader = vk::ImageMemoryBarrier(
+            vk::AccessFlagBits::eTransferRead, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eTransferSrcOptimal,
+            vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image.image,
+            vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, level - 1, 1, 0, image.arrayLayers));
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                      vk::PipelineStageFlagBits::eFragmentShader |
+                                          vk::PipelineStageFlagBits::eComputeShader,
+                                      vk::DependencyFlags(), nullptr, nullptr, toShader);
+
+        width = nextWidth;
+        height = nextHeight;
+    }
+
+    // the last level was only ever written
+    vk::ImageMemoryBarrier lastLevel = vk::ImageMemoryBarrier(
+        vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eTransferDstOptimal,
+        vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image.image,
+        vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, image.mipLevels - 1, 1, 0, image.arrayLayers));
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(),
+        nullptr, nullptr, lastLevel);
+}
+
+bool supports_linear_blit(const vk::PhysicalDevice& physicalDevice, vk::Format format)
+{
+    const vk::FormatFeatureFlags required = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst |
+                                            vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+    return (physicalDevice.getFormatProperties(format).optimalTilingFeatures & required) == required;
+}
+
+uint32_t mip_level_count(vk::Extent2D extent)
+{
+    uint32_t levels = 1;
+    uint32_t size = std::max(extent.width, extent.height);
+    while (size > 1)
+    {
+        size /= 2;
+        levels++;
+    }
+    return levels;
+}
+
+void upload_image(Engine& engine, const Image& image, const void* data, vk::DeviceSize size)
+{
+    Buffer staging = make_buffer(engine, size, vk::BufferUsageFlagBits::eTransferSrc,
+                                 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    std::memcpy(staging.mapped, data, static_cast<size_t>(size));
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        trace->upload(image.image, data, size);
+    }
+
+    engine.immediate_submit(
+        [&](vk::CommandBuffer commandBuffer)
+        {
+            transition_image(commandBuffer, image, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+            vk::BufferImageCopy region = vk::BufferImageCopy(
+                0, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), vk::Offset3D(0, 0, 0),
+                vk::Extent3D(image.extent.width, image.extent.height, 1));
+            commandBuffer.copyBufferToImage(staging.buffer, image.image, vk::ImageLayout::eTransferDstOptimal,
+                                            region);
+            transition_image(commandBuffer, image, vk::ImageLayout::eTransferDstOptimal,
+                             vk::ImageLayout::eShaderReadOnlyOptimal);
+        });
+
+    destroy_buffer(engine, staging);
+}
+} // namespace vtpl
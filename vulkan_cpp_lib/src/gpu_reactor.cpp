@@ -0,0 +1,312 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "gpu_reactor.h"
+#include "command_trace.h"
+#include "telemetry.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <logging.h>
+#include <memory>
+#include <utility>
+
+namespace vtpl
+{
+namespace
+{
+// staging buffer and command buffer of a transfer recorded by the reactor. The staging buffer
+// is normally released on completion; an awaitable dropped without being awaited releases it here
+struct TransferState
+{
+    explicit TransferState(const Engine& engine) : engine(engine) {}
+    ~TransferState()
+    {
+        if (staging.buffer)
+        {
+            destroy_buffer(engine, staging);
+        }
+    }
+    TransferState(const TransferState&) = delete;
+    TransferState& operator=(const TransferState&) = delete;
+
+    const Engine&     engine;
+    vtpl::Buffer      staging;
+    vk::CommandBuffer commandBuffer{nullptr};
+};
+
+const vk::MemoryPropertyFlags hostVisible =
+    vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+} // namespace
+
+GpuReactor::Awaitable::Awaitable(GpuReactor& reactor, std::function<void(vk::Fence)> submitWork,
+                                 std::function<void()> complete, Executor executor)
+    : reactor(reactor), submitWork(std::move(submitWork)), complete(std::move(complete)),
+      executor(std::move(executor))
+{
+}
+
+void GpuReactor::Awaitable::await_suspend(std::coroutine_handle<> handle)
+{
+    // the coroutine may be resumed on another thread before launch returns, so nothing
+    // here may touch the awaitable afterwards
+    reactor.launch(handle, submitWork, std::move(complete), std::move(executor));
+}
+
+GpuReactor::ReadbackAwaitable::ReadbackAwaitable(GpuReactor& reactor, const vtpl::Buffer& source,
+                                                 vk::DeviceSize offset, vk::DeviceSize size, Executor executor)
+    : reactor(reactor), source(source.buffer), offset(offset), size(size), executor(std::move(executor))
+{
+}
+
+void GpuReactor::ReadbackAwaitable::await_suspend(std::coroutine_handle<> handle)
+{
+    auto state = std::make_shared<TransferState>(reactor.engine);
+    state->staging = make_buffer(reactor.engine, size, vk::BufferUsageFlagBits::eTransferDst, hostVisible);
+
+    GpuReactor& owner = reactor;
+    auto        submitWork = [&owner, state, src = source, srcOffset = offset, bytes = size](vk::Fence fence)
+    {
+        state->commandBuffer = owner.record_transfer(
+            [&](vk::CommandBuffer cmd)
+            {
+                cmd.copyBuffer(src, state->staging.buffer, vk::BufferCopy(srcOffset, 0, bytes));
+                vk::MemoryBarrier hostBarrier =
+                    vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+                cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+                                    vk::DependencyFlags(), hostBarrier, nullptr, nullptr);
+            });
+        owner.submit_commands(state->commandBuffer, fence);
+    };
+
+    // runs on the reactor thread before the coroutine resumes, while the awaitable is alive
+    auto complete = [this, &owner, state]()
+    {
+        const auto* bytes = static_cast<const uint8_t*>(state->staging.mapped);
+        data.assign(bytes, bytes + size);
+        destroy_buffer(owner.engine, state->staging);
+        owner.free_transfer(state->commandBuffer);
+    };
+
+    owner.launch(handle, submitWork, std::move(complete), std::move(executor));
+}
+
+GpuReactor::GpuReactor(Engine& engine, SubmissionQueue* submissionQueue)
+    : engine(engine), submissionQueue(submissionQueue)
+{
+    vk::CommandPoolCreateInfo poolInfo = vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eTransient,
+                                                                   engine.get_queue_family_index());
+    commandPool = engine.get_device().createCommandPool(poolInfo);
+
+    thread = std::thread(&GpuReactor::run, this);
+}
+
+GpuReactor::~GpuReactor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_one();
+    // outstanding work is drained before the thread exits, so no coroutine is left hanging
+    thread.join();
+
+    const vk::Device& device = engine.get_device();
+    for (vk::Fence fence : freeFences)
+    {
+        device.destroyFence(fence);
+    }
+    device.destroyCommandPool(commandPool);
+}
+
+GpuReactor::Awaitable GpuReactor::submit(vk::CommandBuffer commandBuffer, Executor executor)
+{
+    auto submitWork = [this, commandBuffer](vk::Fence fence) { submit_commands(commandBuffer, fence); };
+    return Awaitable(*this, submitWork, {}, std::move(executor));
+}
+
+GpuReactor::Awaitable GpuReactor::upload(const vtpl::Buffer& destination, vk::DeviceSize offset, const void* data,
+                                         vk::DeviceSize size, Executor executor)
+{
+    auto state = std::make_shared<TransferState>(engine);
+    state->staging = make_buffer(engine, size, vk::BufferUsageFlagBits::eTransferSrc, hostVisible);
+    std::memcpy(state->staging.mapped, data, static_cast<size_t>(size));
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        trace->upload(destination.buffer, offset, data, size);
+    }
+
+    auto submitWork = [this, state, dst = destination.buffer, offset, size](vk::Fence fence)
+    {
+        state->commandBuffer = record_transfer(
+            [&](vk::CommandBuffer cmd)
+            {
+                cmd.copyBuffer(state->staging.buffer, dst, vk::BufferCopy(0, offset, size));
+                vk::MemoryBarrier barrier =
+                    vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite,
+                                      vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite);
+                cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands,
+                                    vk::DependencyFlags(), barrier, nullptr, nullptr);
+            });
+        submit_commands(state->commandBuffer, fence);
+    };
+    auto complete = [this, state]()
+    {
+        destroy_buffer(engine, state->staging);
+        free_transfer(state->commandBuffer);
+    };
+    return Awaitable(*this, submitWork, complete, std::move(executor));
+}
+
+GpuReactor::ReadbackAwaitable GpuReactor::readback(const vtpl::Buffer& source, vk::DeviceSize offset,
+                                                   vk::DeviceSize size, Executor executor)
+{
+    return ReadbackAwaitable(*this, source, offset, size, std::move(executor));
+}
+
+void GpuReactor::launch(std::coroutine_handle<> handle, const std::function<void(vk::Fence)>& submitWork,
+                        std::function<void()> complete, Executor executor)
+{
+    vk::Fence fence{nullptr};
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeFences.empty())
+        {
+            fence = freeFences.back();
+            freeFences.pop_back();
+        }
+    }
+    if (!fence)
+    {
+        fence = engine.get_device().createFence(vk::FenceCreateInfo());
+    }
+
+    {
+        std::lock_guard<std::mutex> submitLock(submitMutex);
+        try
+        {
+            submitWork(fence);
+        }
+        catch (...)
+        {
+            // nothing was submitted: release what the job holds and fail the co_await
+            if (complete)
+            {
+                complete();
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            freeFences.push_back(fence);
+            throw;
+        }
+
+        const size_t depth = inFlight.fetch_add(1, std::memory_order_relaxed) + 1;
+        Telemetry::instance().set_queue_depth(Telemetry::allStreams, depth);
+        std::lock_guard<std::mutex> lock(mutex);
+        launched.push_back(Job{fence, handle, std::move(complete), std::move(executor)});
+    }
+    wakeup.notify_one();
+}
+
+vk::CommandBuffer GpuReactor::record_transfer(const std::function<void(vk::CommandBuffer)>& record)
+{
+    // recording also needs the pool, so hold it for the whole recording
+    std::lock_guard<std::mutex>   lock(commandMutex);
+    vk::CommandBufferAllocateInfo allocInfo =
+        vk::CommandBufferAllocateInfo(commandPool, vk::CommandBufferLevel::ePrimary, 1);
+    vk::CommandBuffer commandBuffer = engine.get_device().allocateCommandBuffers(allocInfo)[0];
+
+    commandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    record(commandBuffer);
+    commandBuffer.end();
+    return commandBuffer;
+}
+
+void GpuReactor::submit_commands(vk::CommandBuffer commandBuffer, vk::Fence fence)
+{
+    if (submissionQueue)
+    {
+        // waits for the hand-over, so jobs still reach the queue in launch order
+        SubmitPacket packet;
+        packet.commandBuffers.push_back(commandBuffer);
+        packet.fence = fence;
+        submissionQueue->submit(std::move(packet));
+        return;
+    }
+    vk::SubmitInfo submitInfo = vk::SubmitInfo(0, nullptr, nullptr, 1, &commandBuffer);
+    engine.submit(submitInfo, fence);
+}
+
+void GpuReactor::free_transfer(vk::CommandBuffer commandBuffer)
+{
+    std::lock_guard<std::mutex> lock(commandMutex);
+    engine.get_device().freeCommandBuffers(commandPool, commandBuffer);
+}
+
+void GpuReactor::run()
+{
+    const vk::Device& device = engine.get_device();
+
+    std::vector<Job>       active;
+    std::vector<Job>       finished;
+    std::vector<vk::Fence> fences;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (active.empty())
+            {
+                wakeup.wait(lock, [this] { return stopping || !launched.empty(); });
+            }
+            if (stopping && active.empty() && launched.empty())
+            {
+                return;
+            }
+            std::move(launched.begin(), launched.end(), std::back_inserter(active));
+            launched.clear();
+        }
+
+        // One wait for everything in flight. All work goes to the single engine queue, whose
+        // fences signal in submission order, and jobs are queued in the order they were
+        // submitted, so work launched meanwhile cannot finish before the jobs waited on here.
+        // It is picked up next round and the wait needs no timeout.
+        fences.clear();
+        for (const Job& job : active)
+        {
+            fences.push_back(job.fence);
+        }
+        (void)device.waitForFences(fences, VK_FALSE, UINT64_MAX);
+
+        finished.clear();
+        auto pending = std::partition(active.begin(), active.end(), [&device](const Job& job)
+                                      { return device.getFenceStatus(job.fence) != vk::Result::eSuccess; });
+        std::move(pending, active.end(), std::back_inserter(finished));
+        active.erase(pending, active.end());
+
+        for (Job& job : finished)
+        {
+            device.resetFences(job.fence);
+            if (job.complete)
+            {
+                job.complete();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                freeFences.push_back(job.fence);
+            }
+            const size_t depth = inFlight.fetch_sub(1, std::memory_order_relaxed) - 1;
+            Telemetry::instance().set_queue_depth(Telemetry::allStreams, depth);
+
+            if (job.executor)
+            {
+                job.executor(job.handle);
+            }
+            else
+            {
+                job.handle.resume();
+            }
+        }
+    }
+}
+} // namespace vtpl
@@ -0,0 +1,385 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "motion_detector.h"
+#include "command_trace.h"
+#include "pipeline.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <logging.h>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace vtpl
+{
+namespace
+{
+// downscale factor in each direction and workgroup size, see motion_detect.glsl
+constexpr uint32_t downscale = 4;
+constexpr uint32_t blockWidth = 16;
+constexpr uint32_t blockHeight = 8;
+
+constexpr uint32_t flagActive = 1;
+constexpr uint32_t flagInitialize = 2;
+
+// push constants of motion_detect.glsl
+struct MotionParams
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t downWidth;
+    uint32_t downHeight;
+    uint32_t zonesX;
+    uint32_t zonesY;
+    uint32_t threshold;
+    uint32_t learningDivisor;
+};
+
+const char* shader_file(bool subgroupReduction)
+{
+    return subgroupReduction ? "motion_detect_subgroup.comp.spv" : "motion_detect_shared.comp.spv";
+}
+
+uint32_t blocks_x(const MotionConfig& config)
+{
+    return (config.width / downscale + blockWidth - 1) / blockWidth;
+}
+
+uint32_t blocks_y(const MotionConfig& config)
+{
+    return (config.height / downscale + blockHeight - 1) / blockHeight;
+}
+
+void validate(const MotionConfig& config)
+{
+    if (config.width == 0 || config.height == 0 || config.width % downscale != 0 || config.height % downscale != 0)
+    {
+        throw std::invalid_argument("Motion frames of " + std::to_string(config.width) + "x" +
+                                    std::to_string(config.height) + " are not a multiple of 4 in each direction");
+    }
+    if (config.zonesX == 0 || config.zonesY == 0)
+    {
+        throw std::invalid_argument("Motion detection needs at least one zone in each direction");
+    }
+    if (config.learningDivisor == 0)
+    {
+        throw std::invalid_argument("Motion learningDivisor must not be 0");
+    }
+}
+
+uint32_t zone_of(const MotionConfig& config, uint32_t x, uint32_t y)
+{
+    const uint32_t zoneX = (x / blockWidth) * config.zonesX / blocks_x(config);
+    const uint32_t zoneY = (y / blockHeight) * config.zonesY / blocks_y(config);
+    return zoneY * config.zonesX + zoneX;
+}
+} // namespace
+
+std::vector<uint32_t> motion_reference(const MotionConfig& config, const uint8_t* luma,
+                                       std::vector<uint32_t>& background, bool initialize)
+{
+    const uint32_t downWidth = config.width / downscale;
+    const uint32_t downHeight = config.height / downscale;
+
+    std::vector<uint32_t> counts(static_cast<size_t>(config.zonesX) * config.zonesY, 0);
+    background.resize(static_cast<size_t>(downWidth) * downHeight, 0);
+
+    for (uint32_t y = 0; y < downHeight; y++)
+    {
+        for (uint32_t x = 0; x < downWidth; x++)
+        {
+            uint32_t sum = 0;
+            for (uint32_t row = 0; row < downscale; row++)
+            {
+                const uint8_t* pixels = luma + static_cast<size_t>(y * downscale + row) * config.width + x * downscale;
+                sum += pixels[0] + pixels[1] + pixels[2] + pixels[3];
+            }
+            const int current = static_cast<int>((sum / 16) << 8);
+
+            uint32_t& model = background[static_cast<size_t>(y) * downWidth + x];
+            if (initialize)
+            {
+                model = static_cast<uint32_t>(current);
+                continue;
+            }
+
+            const int previous = static_cast<int>(model);
+            const int difference = std::abs(current - previous) / 256;
+            model = static_cast<uint32_t>(previous + (current - previous) / static_cast<int>(config.learningDivisor));
+            if (difference > static_cast<int>(config.threshold))
+            {
+                counts[zone_of(config, x, y)]++;
+            }
+        }
+    }
+    return counts;
+}
+
+MotionDetector::MotionDetector(Engine& engine, uint32_t streamCount, MotionConfig config, MotionReduction reduction,
+                               SubmissionQueue* submissionQueue)
+    : engine(engine), submissionQueue(submissionQueue), streamCount(streamCount), config(config),
+      downWidth(config.width / downscale), downHeight(config.height / downscale),
+      zoneCount(config.zonesX * config.zonesY), initialized(streamCount, false), zonePixels(zoneCount, 0),
+      lastCounts(static_cast<size_t>(streamCount) * zoneCount, 0)
+{
+    validate(config);
+    const vk::Device&             device = engine.get_device();
+    const vk::MemoryPropertyFlags hostVisible =
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+
+    for (uint32_t y = 0; y < downHeight; y++)
+    {
+        for (uint32_t x = 0; x < downWidth; x++)
+        {
+            zonePixels[zone_of(config, x, y)]++;
+        }
+    }
+
+    subgroupReduction = reduction != MotionReduction::SharedMemory && supports_subgroup_reduction();
+    if (reduction == MotionReduction::Subgroup && !subgroupReduction)
+    {
+        throw std::runtime_error("The device has no subgroup arithmetic in compute shaders!");
+    }
+    if (engine.is_debug())
+    {
+        RAY_LOG_INF << "Making a motion detector for " << streamCount << " streams of " << config.width << "x"
+                    << config.height << ", " << (subgroupReduction ? "subgroup" : "shared memory") << " reduction";
+    }
+
+    const vk::DeviceSize frameSize = static_cast<vk::DeviceSize>(config.width) * config.height;
+    const vk::DeviceSize scoreSize = sizeof(uint32_t) * zoneCount * streamCount;
+    lumaBuffer = make_buffer(engine, frameSize * streamCount, vk::BufferUsageFlagBits::eStorageBuffer, hostVisible);
+    backgroundBuffer = make_buffer(engine, sizeof(uint32_t) * downWidth * downHeight * streamCount,
+                                   vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    flagBuffer = make_buffer(engine, sizeof(uint32_t) * streamCount, vk::BufferUsageFlagBits::eStorageBuffer,
+                             hostVisible);
+    scoreBuffer = make_buffer(engine, scoreSize,
+                              vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst |
+                                  vk::BufferUsageFlagBits::eTransferSrc,
+                              vk::MemoryPropertyFlagBits::eDeviceLocal);
+    scoreReadbackBuffer = make_buffer(engine, scoreSize, vk::BufferUsageFlagBits::eTransferDst, hostVisible);
+    std::memset(flagBuffer.mapped, 0, static_cast<size_t>(flagBuffer.size));
+
+    make_descriptors();
+
+    vk::PushConstantRange pushConstantRange =
+        vk::PushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(MotionParams));
+    pipelineLayout = device.createPipelineLayout(
+        vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(), 1, &descriptorSetLayout, 1, &pushConstantRange));
+    pipeline = make_compute_pipeline(device, pipelineLayout, shader_file(subgroupReduction), engine.is_debug());
+
+    // a pool of its own, command pools must not be used from two threads at once
+    commandPool = device.createCommandPool(vk::CommandPoolCreateInfo(
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer, engine.get_queue_family_index()));
+    vk::CommandBufferAllocateInfo allocInfo =
+        vk::CommandBufferAllocateInfo(commandPool, vk::CommandBufferLevel::ePrimary, 1);
+    commandBuffer = device.allocateCommandBuffers(allocInfo)[0];
+    fence = device.createFence(vk::FenceCreateInfo());
+}
+
+MotionDetector::~MotionDetector()
+{
+    const vk::Device& device = engine.get_device();
+
+    device.destroyFence(fence);
+    device.destroyCommandPool(commandPool);
+    device.destroyPipeline(pipeline);
+    device.destroyPipelineLayout(pipelineLayout);
+    device.destroyDescriptorPool(descriptorPool);
+    device.destroyDescriptorSetLayout(descriptorSetLayout);
+
+    destroy_buffer(engine, scoreReadbackBuffer);
+    destroy_buffer(engine, scoreBuffer);
+    destroy_buffer(engine, flagBuffer);
+    destroy_buffer(engine, backgroundBuffer);
+    destroy_buffer(engine, lumaBuffer);
+}
+
+bool MotionDetector::submit_luma(uint32_t stream, const uint8_t* luma)
+{
+    if (stream >= streamCount)
+    {
+        return false;
+    }
+    const size_t frameSize = static_cast<size_t>(config.width) * config.height;
+    std::memcpy(static_cast<uint8_t*>(lumaBuffer.mapped) + frameSize * stream, luma, frameSize);
+
+    auto* flag = static_cast<uint32_t*>(flagBuffer.mapped) + stream;
+    *flag = initialized[stream] ? flagActive : flagActive | flagInitialize;
+    initialized[stream] = true;
+
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        trace->upload(lumaBuffer.buffer, frameSize * stream, luma, frameSize);
+        trace->upload(flagBuffer.buffer, sizeof(uint32_t) * stream, flag, sizeof(uint32_t));
+    }
+    return true;
+}
+
+void MotionDetector::reset_background(uint32_t stream)
+{
+    if (stream < streamCount)
+    {
+        initialized[stream] = false;
+    }
+}
+
+void MotionDetector::detect()
+{
+    const vk::Device& device = engine.get_device();
+    auto*             flags = static_cast<uint32_t*>(flagBuffer.mapped);
+
+    if (std::none_of(flags, flags + streamCount, [](uint32_t f) { return (f & flagActive) != 0; }))
+    {
+        return;
+    }
+
+    commandBuffer.reset();
+    record(commandBuffer);
+
+    if (submissionQueue)
+    {
+        SubmitPacket packet;
+        packet.commandBuffers.push_back(commandBuffer);
+        packet.fence = fence;
+        submissionQueue->submit(std::move(packet));
+    }
+    else
+    {
+        vk::SubmitInfo submitInfo = vk::SubmitInfo(0, nullptr, nullptr, 1, &commandBuffer);
+        engine.submit(submitInfo, fence);
+    }
+    (void)device.waitForFences(fence, VK_TRUE, UINT64_MAX);
+    device.resetFences(fence);
+
+    const auto* counts = static_cast<const uint32_t*>(scoreReadbackBuffer.mapped);
+    for (uint32_t stream = 0; stream < streamCount; stream++)
+    {
+        if ((flags[stream] & flagActive) != 0)
+        {
+            const size_t offset = static_cast<size_t>(stream) * zoneCount;
+            std::copy(counts + offset, counts + offset + zoneCount,
+                      lastCounts.begin() + static_cast<std::ptrdiff_t>(offset));
+        }
+        flags[stream] = 0;
+    }
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        trace->upload(flagBuffer.buffer, 0, flags, flagBuffer.size);
+    }
+}
+
+const uint32_t* MotionDetector::zone_counts(uint32_t stream) const
+{
+    return lastCounts.data() + static_cast<size_t>(stream) * zoneCount;
+}
+
+float MotionDetector::zone_score(uint32_t stream, uint32_t zone) const
+{
+    if (zonePixels[zone] == 0)
+    {
+        return 0.0f;
+    }
+    return static_cast<float>(zone_counts(stream)[zone]) / static_cast<float>(zonePixels[zone]);
+}
+
+bool MotionDetector::supports_subgroup_reduction() const
+{
+    const vk::PhysicalDevice& physicalDevice = engine.get_physical_device();
+    if (physicalDevice.getProperties().apiVersion < VK_API_VERSION_1_1)
+    {
+        return false;
+    }
+
+    auto chain = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties>();
+    const auto& subgroup = chain.get<vk::PhysicalDeviceSubgroupProperties>();
+
+    return (subgroup.supportedStages & vk::ShaderStageFlagBits::eCompute) &&
+           (subgroup.supportedOperations & vk::SubgroupFeatureFlagBits::eBasic) &&
+           (subgroup.supportedOperations & vk::SubgroupFeatureFlagBits::eArithmetic);
+}
+
+void MotionDetector::make_descriptors()
+{
+    const vk::Device& device = engine.get_device();
+
+    std::array<vk::DescriptorSetLayoutBinding, 4> bindings;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(bindings.size()); i++)
+    {
+        bindings[i] =
+            vk::DescriptorSetLayoutBinding(i, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
+    }
+    descriptorSetLayout = device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo(
+        vk::DescriptorSetLayoutCreateFlags(), static_cast<uint32_t>(bindings.size()), bindings.data()));
+
+    vk::DescriptorPoolSize poolSize = vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 4);
+    descriptorPool =
+        device.createDescriptorPool(vk::DescriptorPoolCreateInfo(vk::DescriptorPoolCreateFlags(), 1, 1, &poolSize));
+
+    descriptorSet =
+        device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(descriptorPool, 1, &descriptorSetLayout))[0];
+
+    std::array<vk::DescriptorBufferInfo, 4> bufferInfos = {
+        vk::DescriptorBufferInfo(lumaBuffer.buffer, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(backgroundBuffer.buffer, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(flagBuffer.buffer, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(scoreBuffer.buffer, 0, VK_WHOLE_SIZE)};
+    std::vector<vk::WriteDescriptorSet> writes;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(bufferInfos.size()); i++)
+    {
+        writes.emplace_back(descriptorSet, i, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos[i]);
+    }
+    device.updateDescriptorSets(writes, nullptr);
+}
+
+void MotionDetector::record(const vk::CommandBuffer& cmd)
+{
+    cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    const std::shared_ptr<CommandTrace> trace = engine.get_trace();
+    if (trace != nullptr)
+    {
+        trace->begin(cmd);
+    }
+
+    cmd.fillBuffer(scoreBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+    vk::BufferMemoryBarrier clearBarrier = vk::BufferMemoryBarrier(
+        vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+        VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, scoreBuffer.buffer, 0, VK_WHOLE_SIZE);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+                        vk::DependencyFlags(), nullptr, clearBarrier, nullptr);
+
+    // every stream is a slice of the grid, inactive ones exit immediately
+    MotionParams params{config.width,  config.height,   downWidth,        downHeight, config.zonesX,
+                        config.zonesY, config.threshold, config.learningDivisor};
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSet, nullptr);
+    cmd.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(params), &params);
+    cmd.dispatch(blocks_x(config), blocks_y(config), streamCount);
+    if (trace != nullptr)
+    {
+        trace->dispatch(cmd, shader_file(subgroupReduction),
+                        {lumaBuffer.buffer, backgroundBuffer.buffer, flagBuffer.buffer, scoreBuffer.buffer}, &params,
+                        sizeof(params), blocks_x(config), blocks_y(config), streamCount);
+    }
+
+    vk::BufferMemoryBarrier scoreBarrier = vk::BufferMemoryBarrier(
+        vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead, VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED, scoreBuffer.buffer, 0, VK_WHOLE_SIZE);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+                        vk::DependencyFlags(), nullptr, scoreBarrier, nullptr);
+
+    cmd.copyBuffer(scoreBuffer.buffer, scoreReadbackBuffer.buffer, vk::BufferCopy(0, 0, scoreBuffer.size));
+
+    vk::MemoryBarrier hostBarrier =
+        vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+                        vk::DependencyFlags(), hostBarrier, nullptr, nullptr);
+
+    cmd.end();
+}
+} // namespace vtpl
@@ -0,0 +1,423 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "overlay_renderer.h"
+#include "command_trace.h"
+#include "pipeline.h"
+#include "telemetry.h"
+#include <cstring>
+#include <logging.h>
+#include <utility>
+
+namespace vtpl
+{
+namespace
+{
+constexpr uint32_t kindBox = 0;
+constexpr uint32_t kindSegment = 1;
+constexpr uint32_t kindGlyph = 2;
+constexpr uint32_t cullGroupSize = 64;
+
+// push constants of overlay_cull.comp
+struct CullParams
+{
+    uint32_t primitiveCount;
+    uint32_t tileCount;
+    uint32_t capacity;
+    uint32_t unused;
+};
+
+// push constants of overlay.vert and overlay.frag, the kind is a specialization constant
+struct DrawParams
+{
+    float    targetWidth;
+    float    targetHeight;
+    uint32_t capacity;
+    uint32_t unused;
+};
+} // namespace
+
+OverlayRenderer::OverlayRenderer(Engine& engine, uint32_t width, uint32_t height, uint32_t capacity,
+                                 uint32_t maxTiles)
+    : engine(engine), width(width), height(height), capacity(capacity), maxTiles(maxTiles)
+{
+    const vk::Device&             device = engine.get_device();
+    const vk::MemoryPropertyFlags hostVisible =
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+
+    if (engine.is_debug())
+    {
+        RAY_LOG_INF << "Making an overlay renderer " << width << "x" << height << " for " << capacity << " records";
+    }
+
+    primitiveBuffer = make_buffer(engine, sizeof(Primitive) * capacity, vk::BufferUsageFlagBits::eStorageBuffer,
+                                  hostVisible);
+    tileBuffer = make_buffer(engine, sizeof(TileViewport) * maxTiles, vk::BufferUsageFlagBits::eStorageBuffer,
+                             hostVisible);
+    visibleBuffer = make_buffer(engine, visibleStride * capacity * kindCount, vk::BufferUsageFlagBits::eStorageBuffer,
+                                vk::MemoryPropertyFlagBits::eDeviceLocal);
+    drawBuffer = make_buffer(engine, sizeof(vk::DrawIndirectCommand) * kindCount,
+                             vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer |
+                                 vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc,
+                             vk::MemoryPropertyFlagBits::eDeviceLocal);
+    countBuffer = make_buffer(engine, sizeof(vk::DrawIndirectCommand) * kindCount,
+                              vk::BufferUsageFlagBits::eTransferDst, hostVisible);
+    readbackBuffer = make_buffer(engine, static_cast<vk::DeviceSize>(width) * height * 4,
+                                 vk::BufferUsageFlagBits::eTransferDst, hostVisible);
+    std::memset(countBuffer.mapped, 0, static_cast<size_t>(countBuffer.size));
+
+    target = make_image(engine, vk::Extent2D(width, height), vk::Format::eR8G8B8A8Unorm,
+                        vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc |
+                            vk::ImageUsageFlagBits::eSampled);
+
+    // labels render as nothing until a real atlas is provided
+    const uint8_t emptyAtlas = 0;
+    glyphAtlas = make_image(engine, vk::Extent2D(1, 1), vk::Format::eR8Unorm,
+                            vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst);
+    upload_image(engine, glyphAtlas, &emptyAtlas, sizeof(emptyAtlas));
+
+    vk::SamplerCreateInfo samplerInfo = vk::SamplerCreateInfo(
+        vk::SamplerCreateFlags(), vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eNearest,
+        vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge,
+        vk::SamplerAddressMode::eClampToEdge);
+    atlasSampler = device.createSampler(samplerInfo);
+
+    make_descriptors();
+    make_render_pass();
+    make_pipelines();
+
+    // a pool of its own, command pools must not be used from two threads at once
+    commandPool = device.createCommandPool(vk::CommandPoolCreateInfo(
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer, engine.get_queue_family_index()));
+    vk::CommandBufferAllocateInfo allocInfo =
+        vk::CommandBufferAllocateInfo(commandPool, vk::CommandBufferLevel::ePrimary, 1);
+    commandBuffer = device.allocateCommandBuffers(allocInfo)[0];
+    fence = device.createFence(vk::FenceCreateInfo());
+}
+
+OverlayRenderer::~OverlayRenderer()
+{
+    const vk::Device& device = engine.get_device();
+
+    device.destroyFence(fence);
+    device.destroyCommandPool(commandPool);
+    drawPipelines.reset();
+    device.destroyPipeline(cullPipeline);
+    device.destroyPipelineLayout(pipelineLayout);
+    device.destroyFramebuffer(framebuffer);
+    device.destroyRenderPass(renderPass);
+    device.destroyDescriptorPool(descriptorPool);
+    device.destroyDescriptorSetLayout(descriptorSetLayout);
+    device.destroySampler(atlasSampler);
+
+    destroy_image(engine, glyphAtlas);
+    destroy_image(engine, target);
+    destroy_buffer(engine, readbackBuffer);
+    destroy_buffer(engine, countBuffer);
+    destroy_buffer(engine, drawBuffer);
+    destroy_buffer(engine, visibleBuffer);
+    destroy_buffer(engine, tileBuffer);
+    destroy_buffer(engine, primitiveBuffer);
+}
+
+bool OverlayRenderer::set_tiles(const std::vector<TileViewport>& tiles)
+{
+    if (tiles.size() > maxTiles)
+    {
+        RAY_LOG_ERR << "Overlay renderer supports " << maxTiles << " tiles, " << tiles.size() << " requested";
+        return false;
+    }
+    std::memcpy(tileBuffer.mapped, tiles.data(), tiles.size() * sizeof(TileViewport));
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        trace->upload(tileBuffer.buffer, 0, tiles.data(), tiles.size() * sizeof(TileViewport));
+    }
+    tileCount = static_cast<uint32_t>(tiles.size());
+    return true;
+}
+
+void OverlayRenderer::set_glyph_atlas(uint32_t atlasWidth, uint32_t atlasHeight, const uint8_t* sdf,
+                                      std::unordered_map<uint32_t, GlyphMetrics> metrics)
+{
+    // render() waits for its fence, so the old atlas is no longer in use
+    destroy_image(engine, glyphAtlas);
+    glyphAtlas = make_image(engine, vk::Extent2D(atlasWidth, atlasHeight), vk::Format::eR8Unorm,
+                            vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst);
+    upload_image(engine, glyphAtlas, sdf, static_cast<vk::DeviceSize>(atlasWidth) * atlasHeight);
+    glyphs = std::move(metrics);
+    write_atlas_descriptor();
+}
+
+bool OverlayRenderer::push(const Primitive& primitive)
+{
+    if (primitiveCount >= capacity)
+    {
+        return false;
+    }
+    static_cast<Primitive*>(primitiveBuffer.mapped)[primitiveCount++] = primitive;
+    return true;
+}
+
+bool OverlayRenderer::add_box(uint32_t tile, float x0, float y0, float x1, float y1, uint32_t color,
+                              float thickness)
+{
+    return push(Primitive{{x0, y0, x1, y1}, {}, {}, tile, color, kindBox, thickness});
+}
+
+bool OverlayRenderer::add_track(uint32_t tile, const std::vector<std::array<float, 2>>& points, uint32_t color,
+                                float thickness)
+{
+    if (points.size() < 2)
+    {
+        return true;
+    }
+    if (primitiveCount + points.size() - 1 > capacity)
+    {
+        return false;
+    }
+    for (size_t i = 1; i < points.size(); i++)
+    {
+        push(Primitive{
+            {points[i - 1][0], points[i - 1][1], points[i][0], points[i][1]}, {}, {}, tile, color, kindSegment,
+            thickness});
+    }
+    return true;
+}
+
+bool OverlayRenderer::add_label(uint32_t tile, float x, float y, float pixelSize, const std::string& text,
+                                uint32_t color)
+{
+    size_t glyphCount = 0;
+    for (const char c : text)
+    {
+        glyphCount += glyphs.count(static_cast<unsigned char>(c));
+    }
+    if (primitiveCount + glyphCount > capacity)
+    {
+        return false;
+    }
+
+    float pen = 0.0f;
+    for (const char c : text)
+    {
+        auto it = glyphs.find(static_cast<unsigned char>(c));
+        if (it == glyphs.end())
+        {
+            continue;
+        }
+        const GlyphMetrics& m = it->second;
+        push(Primitive{{x, y, pen + m.offsetX * pixelSize, m.offsetY * pixelSize},
+                       {m.width * pixelSize, m.height * pixelSize, 0.0f, 0.0f},
+                       {m.u0, m.v0, m.u1, m.v1},
+                       tile,
+                       color,
+                       kindGlyph,
+                       0.0f});
+        pen += m.advance * pixelSize;
+    }
+    return true;
+}
+
+void OverlayRenderer::render()
+{
+    const vk::Device& device = engine.get_device();
+
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        // filler would cull every primitive, so they are kept verbatim
+        trace->upload(primitiveBuffer.buffer, 0, primitiveBuffer.mapped, sizeof(Primitive) * primitiveCount, true);
+    }
+    commandBuffer.reset();
+    record(commandBuffer);
+
+    vk::SubmitInfo submitInfo = vk::SubmitInfo(0, nullptr, nullptr, 1, &commandBuffer);
+    engine.submit(submitInfo, fence);
+    (void)device.waitForFences(fence, VK_TRUE, UINT64_MAX);
+    device.resetFences(fence);
+}
+
+std::vector<uint8_t> OverlayRenderer::readback() const
+{
+    StageTimer  timer(Telemetry::allStreams, Stage::Readback);
+    const auto* pixels = static_cast<const uint8_t*>(readbackBuffer.mapped);
+    return std::vector<uint8_t>(pixels, pixels + readbackBuffer.size);
+}
+
+std::array<uint32_t, 3> OverlayRenderer::visible_counts() const
+{
+    const auto* draws = static_cast<const vk::DrawIndirectCommand*>(countBuffer.mapped);
+    return {draws[kindBox].instanceCount, draws[kindSegment].instanceCount, draws[kindGlyph].instanceCount};
+}
+
+void OverlayRenderer::make_descriptors()
+{
+    const vk::Device& device = engine.get_device();
+
+    std::array<vk::DescriptorSetLayoutBinding, 5> bindings = {
+        vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+        vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+        vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1,
+                                       vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eVertex),
+        vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+        vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eCombinedImageSampler, 1,
+                                       vk::ShaderStageFlagBits::eFragment)};
+    descriptorSetLayout = device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo(
+        vk::DescriptorSetLayoutCreateFlags(), static_cast<uint32_t>(bindings.size()), bindings.data()));
+
+    std::array<vk::DescriptorPoolSize, 2> poolSizes = {
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 4),
+        vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, 1)};
+    descriptorPool = device.createDescriptorPool(vk::DescriptorPoolCreateInfo(
+        vk::DescriptorPoolCreateFlags(), 1, static_cast<uint32_t>(poolSizes.size()), poolSizes.data()));
+
+    descriptorSet =
+        device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(descriptorPool, 1, &descriptorSetLayout))[0];
+
+    std::array<vk::DescriptorBufferInfo, 4> bufferInfos = {
+        vk::DescriptorBufferInfo(primitiveBuffer.buffer, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(tileBuffer.buffer, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(visibleBuffer.buffer, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(drawBuffer.buffer, 0, VK_WHOLE_SIZE)};
+    std::vector<vk::WriteDescriptorSet> writes;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(bufferInfos.size()); i++)
+    {
+        writes.emplace_back(descriptorSet, i, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos[i]);
+    }
+    device.updateDescriptorSets(writes, nullptr);
+    write_atlas_descriptor();
+}
+
+void OverlayRenderer::write_atlas_descriptor()
+{
+    vk::DescriptorImageInfo imageInfo =
+        vk::DescriptorImageInfo(atlasSampler, glyphAtlas.view, vk::ImageLayout::eShaderReadOnlyOptimal);
+    vk::WriteDescriptorSet write =
+        vk::WriteDescriptorSet(descriptorSet, 4, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfo);
+    engine.get_device().updateDescriptorSets(write, nullptr);
+}
+
+void OverlayRenderer::make_render_pass()
+{
+    const vk::Device& device = engine.get_device();
+
+    renderPass = make_color_render_pass(device, target.format, vk::ImageLayout::eTransferSrcOptimal);
+    vk::FramebufferCreateInfo framebufferInfo =
+        vk::FramebufferCreateInfo(vk::FramebufferCreateFlags(), renderPass, 1, &target.view, width, height, 1);
+    framebuffer = device.createFramebuffer(framebufferInfo);
+}
+
+void OverlayRenderer::make_pipelines()
+{
+    const vk::Device& device = engine.get_device();
+
+    vk::PushConstantRange pushConstantRange = vk::PushConstantRange(
+        vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0,
+        sizeof(CullParams));
+    pipelineLayout = device.createPipelineLayout(
+        vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(), 1, &descriptorSetLayout, 1, &pushConstantRange));
+
+    cullPipeline = make_compute_pipeline(device, pipelineLayout, "overlay_cull.comp.spv", engine.is_debug());
+    drawPipelines = std::make_unique<PipelineVariants<DrawKey>>(
+        engine,
+        [this](const vk::SpecializationInfo& specialization)
+        {
+            return make_graphics_pipeline(engine.get_device(), pipelineLayout, renderPass, "overlay.vert.spv",
+                                          "overlay.frag.spv", engine.is_debug(), &specialization);
+        });
+    // compile the kinds in the background while the rest of the first frame is set up
+    drawPipelines->prewarm({DrawKey{kindBox}, DrawKey{kindSegment}, DrawKey{kindGlyph}});
+}
+
+void OverlayRenderer::record(const vk::CommandBuffer& cmd)
+{
+    const vk::ShaderStageFlags stages =
+        vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+
+    cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+    // reset the indirect arguments: one quad per instance, no instances yet
+    std::array<vk::DrawIndirectCommand, kindCount> draws;
+    draws.fill(vk::DrawIndirectCommand(6, 0, 0, 0));
+    cmd.updateBuffer(drawBuffer.buffer, 0, sizeof(draws), draws.data());
+    const std::shared_ptr<CommandTrace> trace = engine.get_trace();
+    if (trace != nullptr)
+    {
+        trace->begin(cmd);
+        trace->upload(drawBuffer.buffer, 0, draws.data(), sizeof(draws));
+    }
+
+    vk::BufferMemoryBarrier resetBarrier = vk::BufferMemoryBarrier(
+        vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+        VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, drawBuffer.buffer, 0, VK_WHOLE_SIZE);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+                        vk::DependencyFlags(), nullptr, resetBarrier, nullptr);
+
+    // cull and compact
+    if (primitiveCount > 0)
+    {
+        CullParams cullParams{primitiveCount, tileCount, capacity, 0};
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, cullPipeline);
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSet, nullptr);
+        cmd.pushConstants(pipelineLayout, stages, 0, sizeof(cullParams), &cullParams);
+        cmd.dispatch((primitiveCount + cullGroupSize - 1) / cullGroupSize, 1, 1);
+        if (trace != nullptr)
+        {
+            trace->dispatch(cmd, "overlay_cull.comp.spv",
+                            {primitiveBuffer.buffer, tileBuffer.buffer, visibleBuffer.buffer, drawBuffer.buffer},
+                            &cullParams, sizeof(cullParams), (primitiveCount + cullGroupSize - 1) / cullGroupSize, 1,
+                            1);
+        }
+    }
+
+    std::array<vk::BufferMemoryBarrier, 2> cullBarriers = {
+        vk::BufferMemoryBarrier(vk::AccessFlagBits::eShaderWrite,
+                                vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eTransferRead,
+                                VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, drawBuffer.buffer, 0, VK_WHOLE_SIZE),
+        vk::BufferMemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+                                VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, visibleBuffer.buffer, 0,
+                                VK_WHOLE_SIZE)};
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                        vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader |
+                            vk::PipelineStageFlagBits::eTransfer,
+                        vk::DependencyFlags(), nullptr, cullBarriers, nullptr);
+
+    cmd.copyBuffer(drawBuffer.buffer, countBuffer.buffer, vk::BufferCopy(0, 0, countBuffer.size));
+
+    // draw every kind with a single instanced indirect draw
+    vk::ClearValue clearColor = vk::ClearValue(vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 0.0f}));
+    vk::RenderPassBeginInfo renderPassInfo = vk::RenderPassBeginInfo(
+        renderPass, framebuffer, vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(width, height)), 1, &clearColor);
+    cmd.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+
+    cmd.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f, 1.0f));
+    cmd.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(width, height)));
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, descriptorSet, nullptr);
+    DrawParams drawParams{static_cast<float>(width), static_cast<float>(height), capacity, 0};
+    cmd.pushConstants(pipelineLayout, stages, 0, sizeof(drawParams), &drawParams);
+    for (uint32_t kind = 0; kind < kindCount; kind++)
+    {
+        if (!kindPipelines[kind])
+        {
+            kindPipelines[kind] = drawPipelines->get(DrawKey{kind});
+        }
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, kindPipelines[kind]);
+        cmd.drawIndirect(drawBuffer.buffer, sizeof(vk::DrawIndirectCommand) * kind, 1,
+                         sizeof(vk::DrawIndirectCommand));
+    }
+    cmd.endRenderPass();
+
+    // copy the frame out for readback
+    vk::BufferImageCopy region = vk::BufferImageCopy(
+        0, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), vk::Offset3D(0, 0, 0),
+        vk::Extent3D(width, height, 1));
+    cmd.copyImageToBuffer(target.image, vk::ImageLayout::eTransferSrcOptimal, readbackBuffer.buffer, region);
+
+    vk::MemoryBarrier hostBarrier =
+        vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+                        vk::DependencyFlags(), hostBarrier, nullptr, nullptr);
+
+    cmd.end();
+}
+} // namespace vtpl
@@ -0,0 +1,126 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "pipeline.h"
+#include "shader.h"
+#include <array>
+#include <logging.h>
+
+namespace vtpl
+{
+vk::Pipeline make_compute_pipeline(const vk::Device& device, const vk::PipelineLayout& layout,
+                                   const std::string& shaderFile, bool debug,
+                                   const vk::SpecializationInfo* specialization)
+{
+    if (debug)
+    {
+        RAY_LOG_INF << "Making compute pipeline for \"" << shaderFile << "\"";
+    }
+
+    vk::ShaderModule                  module = make_shader_module(device, shaderFile, debug);
+    vk::PipelineShaderStageCreateInfo stageInfo = vk::PipelineShaderStageCreateInfo(
+        vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eCompute, module, "main", specialization);
+    vk::ComputePipelineCreateInfo pipelineInfo =
+        vk::ComputePipelineCreateInfo(vk::PipelineCreateFlags(), stageInfo, layout);
+
+    vk::Pipeline pipeline = device.createComputePipeline(nullptr, pipelineInfo).value;
+    device.destroyShaderModule(module);
+    return pipeline;
+}
+
+vk::Pipeline make_graphics_pipeline(const vk::Device& device, const vk::PipelineLayout& layout,
+                                    const vk::RenderPass& renderPass, const std::string& vertexShaderFile,
+                                    const std::string& fragmentShaderFile, bool debug,
+                                    const vk::SpecializationInfo* specialization)
+{
+    if (debug)
+    {
+        RAY_LOG_INF << "Making graphics pipeline for \"" << vertexShaderFile << "\" and \"" << fragmentShaderFile
+                    << "\"";
+    }
+
+    vk::ShaderModule vertexModule = make_shader_module(device, vertexShaderFile, debug);
+    vk::ShaderModule fragmentModule = make_shader_module(device, fragmentShaderFile, debug);
+
+    std::array<vk::PipelineShaderStageCreateInfo, 2> stages = {
+        vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eVertex,
+                                          vertexModule, "main", specialization),
+        vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eFragment,
+                                          fragmentModule, "main", specialization)};
+
+    // geometry is pulled from storage buffers in the vertex shader
+    vk::PipelineVertexInputStateCreateInfo   vertexInput = vk::PipelineVertexInputStateCreateInfo();
+    vk::PipelineInputAssemblyStateCreateInfo inputAssembly = vk::PipelineInputAssemblyStateCreateInfo(
+        vk::PipelineInputAssemblyStateCreateFlags(), vk::PrimitiveTopology::eTriangleList, VK_FALSE);
+
+    vk::PipelineViewportStateCreateInfo viewportState =
+        vk::PipelineViewportStateCreateInfo(vk::PipelineViewportStateCreateFlags(), 1, nullptr, 1, nullptr);
+
+    vk::PipelineRasterizationStateCreateInfo rasterizer = vk::PipelineRasterizationStateCreateInfo(
+        vk::PipelineRasterizationStateCreateFlags(), VK_FALSE, VK_FALSE, vk::PolygonMode::eFill,
+        vk::CullModeFlagBits::eNone, vk::FrontFace::eClockwise, VK_FALSE, 0.0f, 0.0f, 0.0f, 1.0f);
+
+    vk::PipelineMultisampleStateCreateInfo multisampling = vk::PipelineMultisampleStateCreateInfo(
+        vk::PipelineMultisampleStateCreateFlags(), vk::SampleCountFlagBits::e1, VK_FALSE);
+
+    vk::PipelineColorBlendAttachmentState blendAttachment = vk::PipelineColorBlendAttachmentState(
+        VK_TRUE, vk::BlendFactor::eSrcAlpha, vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd,
+        vk::BlendFactor::eOne, vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd,
+        vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB |
+            vk::ColorComponentFlagBits::eA);
+    vk::PipelineColorBlendStateCreateInfo colorBlending = vk::PipelineColorBlendStateCreateInfo(
+        vk::PipelineColorBlendStateCreateFlags(), VK_FALSE, vk::LogicOp::eCopy, 1, &blendAttachment);
+
+    std::array<vk::DynamicState, 2>    dynamicStates = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    vk::PipelineDynamicStateCreateInfo dynamicState = vk::PipelineDynamicStateCreateInfo(
+        vk::PipelineDynamicStateCreateFlags(), static_cast<uint32_t>(dynamicStates.size()), dynamicStates.data());
+
+    vk::GraphicsPipelineCreateInfo pipelineInfo = vk::GraphicsPipelineCreateInfo(
+        vk::PipelineCreateFlags(), static_cast<uint32_t>(stages.size()), stages.data(), &vertexInput,
+        &inputAssembly, nullptr, &viewportState, &rasterizer, &multisampling, nullptr, &colorBlending,
+        &dynamicState, layout, renderPass, 0);
+
+    vk::Pipeline pipeline = device.createGraphicsPipeline(nullptr, pipelineInfo).value;
+    device.destroyShaderModule(vertexModule);
+    device.destroyShaderModule(fragmentModule);
+    return pipeline;
+}
+
+vk::RenderPass make_color_render_pass(const vk::Device& device, vk::Format format, vk::ImageLayout finalLayout,
+                                      vk::AttachmentLoadOp loadOp)
+{
+    // loaded attachments keep their contents between frames, so they start where they were left
+    const vk::ImageLayout initialLayout =
+        loadOp == vk::AttachmentLoadOp::eLoad ? finalLayout : vk::ImageLayout::eUndefined;
+
+    vk::AttachmentDescription colorAttachment = vk::AttachmentDescription(
+        vk::AttachmentDescriptionFlags(), format, vk::SampleCountFlagBits::e1, loadOp, vk::AttachmentStoreOp::eStore,
+        vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, initialLayout, finalLayout);
+
+    vk::AttachmentReference colorReference =
+        vk::AttachmentReference(0, vk::ImageLayout::eColorAttachmentOptimal);
+    vk::SubpassDescription subpass = vk::SubpassDescription(
+        vk::SubpassDescriptionFlags(), vk::PipelineBindPoint::eGraphics, 0, nullptr, 1, &colorReference);
+
+    /*
+     * Make the previous frame's copy out of the attachment and any clear of it finish before
+     * it is loaded or cleared, and the writes of this frame visible to whatever reads the
+     * attachment afterwards.
+     */
+    std::array<vk::SubpassDependency, 2> dependencies = {
+        vk::SubpassDependency(VK_SUBPASS_EXTERNAL, 0,
+                              vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eFragmentShader,
+                              vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::AccessFlagBits::eTransferWrite,
+                              vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite),
+        vk::SubpassDependency(0, VK_SUBPASS_EXTERNAL, vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                              vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eFragmentShader,
+                              vk::AccessFlagBits::eColorAttachmentWrite,
+                              vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eShaderRead)};
+
+    vk::RenderPassCreateInfo renderPassInfo =
+        vk::RenderPassCreateInfo(vk::RenderPassCreateFlags(), 1, &colorAttachment, 1, &subpass,
+                                 static_cast<uint32_t>(dependencies.size()), dependencies.data());
+    return device.createRenderPass(renderPassInfo);
+}
+} // namespace vtpl
@@ -0,0 +1,294 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "residency_cache.h"
+#include <logging.h>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace vtpl
+{
+ResidencyCache::ResidencyCache(Engine& engine, float budgetFraction, vk::DeviceSize byteLimit)
+    : engine(engine), budgetFraction(budgetFraction), byteLimit(byteLimit),
+      memoryProperties(engine.get_physical_device().getMemoryProperties())
+{
+    cachedBytes.assign(memoryProperties.memoryHeapCount, 0);
+}
+
+ResidencyCache::~ResidencyCache()
+{
+    for (auto& [key, entry] : entries)
+    {
+        destroy(entry);
+    }
+}
+
+ResidencyCache::ImageLease ResidencyCache::acquire_image(Key key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto                        found = entries.find(key);
+    if (found == entries.end() || !found->second.image)
+    {
+        counters.misses++;
+        return ImageLease();
+    }
+    counters.hits++;
+    recency.splice(recency.begin(), recency, found->second.recent);
+    found->second.pins++;
+    return ImageLease(this, key, *found->second.image);
+}
+
+ResidencyCache::BufferLease ResidencyCache::acquire_buffer(Key key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto                        found = entries.find(key);
+    if (found == entries.end() || !found->second.buffer)
+    {
+        counters.misses++;
+        return BufferLease();
+    }
+    counters.hits++;
+    recency.splice(recency.begin(), recency, found->second.recent);
+    found->second.pins++;
+    return BufferLease(this, key, *found->second.buffer);
+}
+
+ResidencyCache::ImageLease ResidencyCache::insert_image(Key key, vk::Extent2D extent, vk::Format format,
+                                                        vk::ImageUsageFlags usage, uint32_t mipLevels, bool pinned)
+{
+    const vk::MemoryRequirements requirements = image_requirements(engine, extent, format, usage, mipLevels);
+    const uint32_t               heap = heap_of(requirements, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    replace_locked(key);
+    make_room(heap, requirements.size);
+
+    Entry entry;
+    entry.heap = heap;
+    entry.bytes = requirements.size;
+    // one pin for the returned lease
+    entry.pins = pinned ? 2 : 1;
+    for (;;)
+    {
+        try
+        {
+            entry.image = make_image(engine, extent, format, usage, mipLevels);
+            break;
+        }
+        catch (const vk::OutOfDeviceMemoryError&)
+        {
+            // the budget was optimistic, keep evicting while there is something to evict
+            if (!evict_one(heap))
+            {
+                throw;
+            }
+        }
+    }
+    store(key, std::move(entry));
+    return ImageLease(this, key, *entries.at(key).image);
+}
+
+ResidencyCache::BufferLease ResidencyCache::insert_buffer(Key key, vk::DeviceSize size, vk::BufferUsageFlags usage,
+                                                          vk::MemoryPropertyFlags properties, bool pinned)
+{
+    const vk::MemoryRequirements requirements = buffer_requirements(engine, size, usage);
+    const uint32_t               heap = heap_of(requirements, properties);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    replace_locked(key);
+    make_room(heap, requirements.size);
+
+    Entry entry;
+    entry.heap = heap;
+    entry.bytes = requirements.size;
+    // one pin for the returned lease
+    entry.pins = pinned ? 2 : 1;
+    for (;;)
+    {
+        try
+        {
+            entry.buffer = make_buffer(engine, size, usage, properties);
+            break;
+        }
+        catch (const vk::OutOfDeviceMemoryError&)
+        {
+            if (!evict_one(heap))
+            {
+                throw;
+            }
+        }
+    }
+    store(key, std::move(entry));
+    return BufferLease(this, key, *entries.at(key).buffer);
+}
+
+void ResidencyCache::pin(Key key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto                        found = entries.find(key);
+    if (found != entries.end())
+    {
+        found->second.pins++;
+    }
+}
+
+void ResidencyCache::unpin(Key key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto                        found = entries.find(key);
+    if (found != entries.end() && found->second.pins > 0)
+    {
+        found->second.pins--;
+    }
+}
+
+bool ResidencyCache::erase(Key key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto                        found = entries.find(key);
+    if (found != entries.end() && found->second.pins > 0)
+    {
+        return false;
+    }
+    erase_locked(key);
+    return true;
+}
+
+std::vector<HeapUsage> ResidencyCache::heap_usage() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return query_heaps();
+}
+
+ResidencyStats ResidencyCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+uint32_t ResidencyCache::heap_of(const vk::MemoryRequirements& requirements,
+                                 vk::MemoryPropertyFlags properties) const
+{
+    const uint32_t type =
+        find_memory_type(engine.get_physical_device(), requirements.memoryTypeBits, properties);
+    return memoryProperties.memoryTypes[type].heapIndex;
+}
+
+std::vector<HeapUsage> ResidencyCache::query_heaps() const
+{
+    std::vector<HeapUsage> heaps(memoryProperties.memoryHeapCount);
+
+    if (engine.has_memory_budget())
+    {
+        /*
+         * The reported usage covers every allocation from the heap, including those of
+         * other processes, and the budget shrinks as the system comes under pressure.
+         */
+        auto chain = engine.get_physical_device()
+                         .getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2,
+                                               vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        const auto& budget = chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+        {
+            heaps[i].budget = static_cast<vk::DeviceSize>(static_cast<double>(budget.heapBudget[i]) * budgetFraction);
+            heaps[i].usage = budget.heapUsage[i];
+            heaps[i].cached = cachedBytes[i];
+        }
+        return heaps;
+    }
+
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+    {
+        heaps[i].budget =
+            static_cast<vk::DeviceSize>(static_cast<double>(memoryProperties.memoryHeaps[i].size) * budgetFraction);
+        heaps[i].usage = cachedBytes[i];
+        heaps[i].cached = cachedBytes[i];
+    }
+    return heaps;
+}
+
+void ResidencyCache::make_room(uint32_t heap, vk::DeviceSize bytes)
+{
+    const HeapUsage      current = query_heaps()[heap];
+    const vk::DeviceSize cachedBefore = cachedBytes[heap];
+
+    // freed memory may not show up in the reported usage right away, so track it here
+    while (current.usage - (cachedBefore - cachedBytes[heap]) + bytes > current.budget ||
+           (byteLimit != 0 && cachedBytes[heap] + bytes > byteLimit))
+    {
+        if (!evict_one(heap))
+        {
+            counters.overBudget++;
+            RAY_LOG_ERR << "Heap " << heap << " is over budget and has nothing left to evict";
+            return;
+        }
+    }
+}
+
+bool ResidencyCache::evict_one(uint32_t heap)
+{
+    for (auto it = recency.rbegin(); it != recency.rend(); ++it)
+    {
+        Entry& entry = entries.at(*it);
+        if (entry.heap != heap || entry.pins > 0)
+        {
+            continue;
+        }
+        counters.evictions++;
+        counters.evictedBytes += entry.bytes;
+        erase_locked(*it);
+        return true;
+    }
+    return false;
+}
+
+void ResidencyCache::replace_locked(Key key)
+{
+    auto found = entries.find(key);
+    if (found == entries.end())
+    {
+        return;
+    }
+    if (found->second.pins > 0)
+    {
+        // work in flight may still use it, and a pin cannot tell the old resource from the new
+        throw std::runtime_error("Resource " + std::to_string(key) + " is pinned and cannot be replaced");
+    }
+    erase_locked(key);
+}
+
+void ResidencyCache::erase_locked(Key key)
+{
+    auto found = entries.find(key);
+    if (found == entries.end())
+    {
+        return;
+    }
+    destroy(found->second);
+    recency.erase(found->second.recent);
+    entries.erase(found);
+}
+
+void ResidencyCache::destroy(Entry& entry)
+{
+    if (entry.image)
+    {
+        destroy_image(engine, *entry.image);
+    }
+    if (entry.buffer)
+    {
+        destroy_buffer(engine, *entry.buffer);
+    }
+    cachedBytes[entry.heap] -= entry.bytes;
+}
+
+void ResidencyCache::store(Key key, Entry entry)
+{
+    cachedBytes[entry.heap] += entry.bytes;
+    recency.push_front(key);
+    entry.recent = recency.begin();
+    entries.emplace(key, std::move(entry));
+}
+} // namespace vtpl
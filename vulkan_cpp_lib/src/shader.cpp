@@ -0,0 +1,45 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "shader.h"
+#include <fstream>
+#include <logging.h>
+#include <stdexcept>
+
+#ifndef VTPL_SHADER_DIR
+#define VTPL_SHADER_DIR "shaders/"
+#endif
+
+namespace vtpl
+{
+std::vector<uint32_t> read_shader_file(const std::string& filename, bool debug)
+{
+    const std::string path = std::string(VTPL_SHADER_DIR) + filename;
+    std::ifstream     file(path, std::ios::ate | std::ios::binary);
+
+    if (!file.is_open())
+    {
+        RAY_LOG_ERR << "Failed to load \"" << path << "\"";
+        throw std::runtime_error("Failed to load shader " + path);
+    }
+    if (debug)
+    {
+        RAY_LOG_INF << "Loading shader \"" << path << "\"";
+    }
+
+    const auto            fileSize = static_cast<size_t>(file.tellg());
+    std::vector<uint32_t> buffer((fileSize + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(fileSize));
+    return buffer;
+}
+
+vk::ShaderModule make_shader_module(const vk::Device& device, const std::string& filename, bool debug)
+{
+    std::vector<uint32_t>      code = read_shader_file(filename, debug);
+    vk::ShaderModuleCreateInfo moduleInfo =
+        vk::ShaderModuleCreateInfo(vk::ShaderModuleCreateFlags(), code.size() * sizeof(uint32_t), code.data());
+    return device.createShaderModule(moduleInfo);
+}
+} // namespace vtpl
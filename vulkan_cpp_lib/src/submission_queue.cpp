@@ -0,0 +1,269 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "submission_queue.h"
+#include <algorithm>
+#include <future>
+#include <logging.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace vtpl
+{
+SubmissionQueue::SubmissionQueue(Engine& engine, std::chrono::microseconds latencyBudget, size_t maxBatch)
+    : engine(engine), latencyBudget(latencyBudget), maxBatch(maxBatch == 0 ? 1 : maxBatch),
+      intervalStart(std::chrono::steady_clock::now())
+{
+    // the list always holds one node whose packet has already been consumed
+    Node* stub = new Node();
+    head.store(stub, std::memory_order_relaxed);
+    tail = stub;
+
+    thread = std::thread(&SubmissionQueue::run, this);
+}
+
+SubmissionQueue::~SubmissionQueue()
+{
+    stopping.store(true, std::memory_order_release);
+    wake();
+    // whatever was pushed before destruction is still submitted
+    thread.join();
+    delete tail;
+}
+
+void SubmissionQueue::push(SubmitPacket packet)
+{
+    Node* node = new Node();
+    node->item.packet = std::move(packet);
+    node->item.enqueued = std::chrono::steady_clock::now();
+
+    Node* previous = head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+
+    wake();
+}
+
+void SubmissionQueue::submit(SubmitPacket packet)
+{
+    // shared with the callback, which may still be inside set_value when this call returns
+    auto                    submitted = std::make_shared<std::promise<vk::Result>>();
+    std::future<vk::Result> result = submitted->get_future();
+    packet.onSubmit = [submitted, onSubmit = std::move(packet.onSubmit)](vk::Result outcome)
+    {
+        if (onSubmit)
+        {
+            onSubmit(outcome);
+        }
+        submitted->set_value(outcome);
+    };
+    push(std::move(packet));
+
+    const vk::Result outcome = result.get();
+    if (outcome != vk::Result::eSuccess)
+    {
+        throw std::runtime_error("Submit through the submission queue failed: " + vk::to_string(outcome));
+    }
+}
+
+SubmissionStats SubmissionQueue::stats()
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    SubmissionStats             result;
+    result.packets = packets.load(std::memory_order_relaxed);
+    result.submits = submits.load(std::memory_order_relaxed);
+    result.failedSubmits = failedSubmits.load(std::memory_order_relaxed);
+    result.failedPackets = failedPackets.load(std::memory_order_relaxed);
+    result.maxBatch = maxBatchSeen.load(std::memory_order_relaxed);
+    result.maxQueueingDelay = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::nanoseconds(maxDelayNs.load(std::memory_order_relaxed)));
+    if (result.submits > 0)
+    {
+        result.meanBatch = static_cast<double>(result.packets) / static_cast<double>(result.submits);
+    }
+    if (result.packets > 0)
+    {
+        result.meanQueueingDelay = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::nanoseconds(totalDelayNs.load(std::memory_order_relaxed) / result.packets));
+    }
+
+    const auto                          now = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> elapsed = now - intervalStart;
+    if (elapsed.count() > 0.0)
+    {
+        result.submitsPerSecond = static_cast<double>(result.submits - intervalSubmits) / elapsed.count();
+    }
+    intervalStart = now;
+    intervalSubmits = result.submits;
+    return result;
+}
+
+SubmissionQueue::Node* SubmissionQueue::pop()
+{
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (!next)
+    {
+        return nullptr;
+    }
+    // the popped node becomes the new stub, its item is moved out before the next pop frees it
+    delete tail;
+    tail = next;
+    return next;
+}
+
+void SubmissionQueue::wake()
+{
+    // sequentially consistent with sleeping, so either the owner thread sees the new signal
+    // before it sleeps or this thread sees it sleeping and wakes it
+    signal.fetch_add(1);
+    if (sleeping.load())
+    {
+        std::lock_guard<std::mutex> lock(waitMutex);
+        wakeup.notify_one();
+    }
+}
+
+void SubmissionQueue::wait_for_signal(uint32_t seen)
+{
+    std::unique_lock<std::mutex> lock(waitMutex);
+    sleeping.store(true);
+    wakeup.wait(lock, [&] { return signal.load() != seen; });
+    sleeping.store(false);
+}
+
+void SubmissionQueue::wait_for_signal(uint32_t seen, std::chrono::steady_clock::time_point deadline)
+{
+    std::unique_lock<std::mutex> lock(waitMutex);
+    sleeping.store(true);
+    wakeup.wait_until(lock, deadline, [&] { return signal.load() != seen; });
+    sleeping.store(false);
+}
+
+vk::Result SubmissionQueue::submit_packets(const Queued* first, size_t count)
+{
+    std::vector<vk::SubmitInfo> submitInfos;
+    submitInfos.reserve(count);
+    vk::Fence fence{nullptr};
+    for (const Queued* queued = first; queued != first + count; queued++)
+    {
+        const SubmitPacket& packet = queued->packet;
+        submitInfos.push_back(vk::SubmitInfo(packet.waitSemaphores, packet.waitStages, packet.commandBuffers,
+                                             packet.signalSemaphores));
+        if (packet.fence)
+        {
+            fence = packet.fence;
+        }
+    }
+
+    try
+    {
+        engine.submit(submitInfos, fence);
+    }
+    catch (const vk::SystemError& error)
+    {
+        RAY_LOG_ERR << "Submit of " << count << " packets failed: " << error.what();
+        failedSubmits.fetch_add(1, std::memory_order_relaxed);
+        return static_cast<vk::Result>(error.code().value());
+    }
+    submits.fetch_add(1, std::memory_order_relaxed);
+    return vk::Result::eSuccess;
+}
+
+void SubmissionQueue::submit_batch(const std::vector<Queued>& batch)
+{
+    const auto submitted = std::chrono::steady_clock::now();
+
+    // a failed submit leaves its semaphores and fence untouched, so the packets can be retried
+    std::vector<vk::Result> results(batch.size(), submit_packets(batch.data(), batch.size()));
+    const bool              merged = results.front() == vk::Result::eSuccess;
+    if (!merged && batch.size() > 1)
+    {
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            results[i] = submit_packets(&batch[i], 1);
+        }
+    }
+
+    uint64_t accepted = 0;
+    uint64_t batchDelayNs = 0;
+    uint64_t longestNs = 0;
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        if (results[i] != vk::Result::eSuccess)
+        {
+            failedPackets.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            const auto delayNs = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(submitted - batch[i].enqueued).count());
+            batchDelayNs += delayNs;
+            longestNs = std::max(longestNs, delayNs);
+            accepted++;
+        }
+        if (batch[i].packet.onSubmit)
+        {
+            batch[i].packet.onSubmit(results[i]);
+        }
+    }
+
+    packets.fetch_add(accepted, std::memory_order_relaxed);
+    totalDelayNs.fetch_add(batchDelayNs, std::memory_order_relaxed);
+    // the maxima have a single writer, the owner thread; retried packets went one per submit
+    const size_t largest = merged ? batch.size() : std::min<size_t>(accepted, 1);
+    if (largest > maxBatchSeen.load(std::memory_order_relaxed))
+    {
+        maxBatchSeen.store(largest, std::memory_order_relaxed);
+    }
+    if (longestNs > maxDelayNs.load(std::memory_order_relaxed))
+    {
+        maxDelayNs.store(longestNs, std::memory_order_relaxed);
+    }
+}
+
+void SubmissionQueue::run()
+{
+    std::vector<Queued> batch;
+    batch.reserve(maxBatch);
+
+    for (;;)
+    {
+        const uint32_t seen = signal.load();
+        Node*          first = pop();
+        if (!first)
+        {
+            // a producer may still be linking its node in, so only stop once head is the stub
+            if (stopping.load(std::memory_order_acquire) && head.load(std::memory_order_acquire) == tail)
+            {
+                return;
+            }
+            wait_for_signal(seen);
+            continue;
+        }
+
+        batch.clear();
+        batch.push_back(std::move(first->item));
+
+        const auto deadline = batch.front().enqueued + latencyBudget;
+        while (batch.size() < maxBatch && !batch.back().packet.fence)
+        {
+            const uint32_t before = signal.load();
+            Node*          node = pop();
+            if (node)
+            {
+                batch.push_back(std::move(node->item));
+                continue;
+            }
+            if (std::chrono::steady_clock::now() >= deadline || stopping.load(std::memory_order_acquire))
+            {
+                break;
+            }
+            wait_for_signal(before, deadline);
+        }
+
+        submit_batch(batch);
+    }
+}
+} // namespace vtpl
@@ -0,0 +1,411 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "swapchain.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <logging.h>
+#include <stdexcept>
+
+namespace vtpl
+{
+namespace
+{
+vk::PresentModeKHR to_vulkan(PresentMode presentMode)
+{
+    switch (presentMode)
+    {
+    case PresentMode::Mailbox:
+        return vk::PresentModeKHR::eMailbox;
+    case PresentMode::Immediate:
+        return vk::PresentModeKHR::eImmediate;
+    default:
+        return vk::PresentModeKHR::eFifo;
+    }
+}
+
+vk::SurfaceFormatKHR choose_surface_format(const std::vector<vk::SurfaceFormatKHR>& formats)
+{
+    for (const vk::SurfaceFormatKHR& candidate : formats)
+    {
+        if (candidate.format == vk::Format::eB8G8R8A8Srgb &&
+            candidate.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear)
+        {
+            return candidate;
+        }
+    }
+    return formats.front();
+}
+
+vk::CompositeAlphaFlagBitsKHR choose_composite_alpha(vk::CompositeAlphaFlagsKHR supported)
+{
+    for (vk::CompositeAlphaFlagBitsKHR candidate :
+         {vk::CompositeAlphaFlagBitsKHR::eOpaque, vk::CompositeAlphaFlagBitsKHR::eInherit,
+          vk::CompositeAlphaFlagBitsKHR::ePreMultiplied, vk::CompositeAlphaFlagBitsKHR::ePostMultiplied})
+    {
+        if (supported & candidate)
+        {
+            return candidate;
+        }
+    }
+    return vk::CompositeAlphaFlagBitsKHR::eOpaque;
+}
+
+std::chrono::microseconds to_microseconds(double seconds)
+{
+    return std::chrono::microseconds(static_cast<int64_t>(seconds * 1e6));
+}
+} // namespace
+
+Swapchain::Swapchain(Engine& engine, vk::SurfaceKHR surface, vk::Extent2D extent, PresentMode presentMode,
+                     uint32_t imageCount, uint32_t framesInFlight)
+    : engine(engine), surface(surface), requestedExtent(extent), requestedMode(presentMode),
+      requestedImageCount(imageCount)
+{
+    // the surface is owned from here on, so every failure below releases it with the rest
+    try
+    {
+        if (!engine.get_physical_device().getSurfaceSupportKHR(engine.get_queue_family_index(), surface))
+        {
+            throw std::runtime_error("The engine queue family cannot present to this surface!");
+        }
+
+        const vk::Device& device = engine.get_device();
+        framesInFlight = std::max(framesInFlight, 1U);
+        for (uint32_t i = 0; i < framesInFlight; i++)
+        {
+            acquired.push_back(device.createSemaphore(vk::SemaphoreCreateInfo()));
+            fences.push_back(device.createFence(vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled)));
+        }
+        acquireTimes.resize(framesInFlight);
+        unsubmitted.assign(framesInFlight, false);
+
+        recreate();
+    }
+    catch (...)
+    {
+        destroy_all();
+        throw;
+    }
+}
+
+Swapchain::~Swapchain()
+{
+    try
+    {
+        for (size_t slot = 0; slot < fences.size(); slot++)
+        {
+            retire_unsubmitted(slot);
+        }
+    }
+    catch (const vk::SystemError& error)
+    {
+        RAY_LOG_ERR << "Could not retire an unsubmitted frame: " << error.what();
+    }
+    (void)engine.get_device().waitForFences(fences, VK_TRUE, UINT64_MAX);
+    destroy_all();
+}
+
+void Swapchain::destroy_all()
+{
+    const vk::Device& device = engine.get_device();
+
+    release_retired(true);
+    for (vk::ImageView view : views)
+    {
+        device.destroyImageView(view);
+    }
+    for (vk::Semaphore semaphore : rendered)
+    {
+        device.destroySemaphore(semaphore);
+    }
+    device.destroySwapchainKHR(swapchain);
+    for (vk::Semaphore semaphore : acquired)
+    {
+        device.destroySemaphore(semaphore);
+    }
+    for (vk::Fence fence : fences)
+    {
+        device.destroyFence(fence);
+    }
+    engine.get_instance().destroySurfaceKHR(surface);
+}
+
+vk::SurfaceKHR Swapchain::make_headless_surface(const Engine& engine)
+{
+    if (!engine.has_headless_surface())
+    {
+        throw std::runtime_error("VK_EXT_headless_surface is not available!");
+    }
+    return engine.get_instance().createHeadlessSurfaceEXT(vk::HeadlessSurfaceCreateInfoEXT(), nullptr,
+                                                          engine.get_dispatch());
+}
+
+std::optional<SwapchainFrame> Swapchain::acquire()
+{
+    const vk::Device& device = engine.get_device();
+    const size_t      slot = static_cast<size_t>(frameNumber % fences.size());
+
+    // the fence is only reset by submit, so a failed attempt or a dropped frame never leaves
+    // the slot waiting on work that was not submitted
+    retire_unsubmitted(slot);
+    (void)device.waitForFences(fences[slot], VK_TRUE, UINT64_MAX);
+    release_retired(false);
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        if (outOfDate)
+        {
+            recreate();
+        }
+        if (!swapchain)
+        {
+            return std::nullopt;
+        }
+
+        uint32_t imageIndex = 0;
+        try
+        {
+            vk::ResultValue<uint32_t> result =
+                device.acquireNextImageKHR(swapchain, UINT64_MAX, acquired[slot], nullptr);
+            if (result.result == vk::Result::eSuboptimalKHR)
+            {
+                // still presentable, rebuild before the next frame
+                outOfDate = true;
+            }
+            imageIndex = result.value;
+        }
+        catch (const vk::OutOfDateKHRError&)
+        {
+            outOfDate = true;
+            continue;
+        }
+
+        unsubmitted[slot] = true;
+        acquireTimes[slot] = std::chrono::steady_clock::now();
+        frameNumber++;
+
+        SwapchainFrame frame;
+        frame.imageIndex = imageIndex;
+        frame.slot = static_cast<uint32_t>(slot);
+        frame.image = images[imageIndex];
+        frame.view = views[imageIndex];
+        frame.acquired = acquired[slot];
+        frame.rendered = rendered[imageIndex];
+        return frame;
+    }
+    return std::nullopt;
+}
+
+void Swapchain::submit(const SwapchainFrame& frame, vk::ArrayProxy<const vk::CommandBuffer> commandBuffers)
+{
+    const vk::PipelineStageFlags waitStage =
+        vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eTransfer;
+    vk::SubmitInfo submitInfo = vk::SubmitInfo(1, &frame.acquired, &waitStage, commandBuffers.size(),
+                                               commandBuffers.data(), 1, &frame.rendered);
+    engine.get_device().resetFences(fences[frame.slot]);
+    // when the submit throws, the slot stays unsubmitted and the next acquire signals its fence
+    engine.submit(submitInfo, fences[frame.slot]);
+    unsubmitted[frame.slot] = false;
+}
+
+void Swapchain::present(const SwapchainFrame& frame)
+{
+    vk::PresentInfoKHR presentInfo = vk::PresentInfoKHR(1, &frame.rendered, 1, &swapchain, &frame.imageIndex);
+    try
+    {
+        if (engine.present(presentInfo) == vk::Result::eSuboptimalKHR)
+        {
+            outOfDate = true;
+        }
+    }
+    catch (const vk::OutOfDateKHRError&)
+    {
+        outOfDate = true;
+    }
+
+    record_present(acquireTimes[frame.slot]);
+}
+
+void Swapchain::resize(vk::Extent2D extent)
+{
+    requestedExtent = extent;
+    outOfDate = true;
+}
+
+void Swapchain::set_present_mode(PresentMode presentMode)
+{
+    requestedMode = presentMode;
+    outOfDate = true;
+}
+
+PresentStats Swapchain::stats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    PresentStats                result = counters;
+    if (result.presents > 1)
+    {
+        result.meanInterval = to_microseconds(intervalMean);
+        result.intervalJitter = to_microseconds(std::sqrt(intervalM2 / static_cast<double>(result.presents - 1)));
+    }
+    if (result.presents > 0)
+    {
+        result.meanFrameLatency = to_microseconds(latencySum / static_cast<double>(result.presents));
+    }
+    return result;
+}
+
+void Swapchain::recreate()
+{
+    const vk::PhysicalDevice& physicalDevice = engine.get_physical_device();
+    const vk::Device&         device = engine.get_device();
+
+    vk::SurfaceCapabilitiesKHR capabilities = physicalDevice.getSurfaceCapabilitiesKHR(surface);
+    if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
+    {
+        extent = capabilities.currentExtent;
+    }
+    else
+    {
+        // headless and some window systems let the swapchain pick its size
+        extent.width = std::clamp(requestedExtent.width, capabilities.minImageExtent.width,
+                                  capabilities.maxImageExtent.width);
+        extent.height = std::clamp(requestedExtent.height, capabilities.minImageExtent.height,
+                                   capabilities.maxImageExtent.height);
+    }
+    if (extent.width == 0 || extent.height == 0)
+    {
+        // minimized, try again on the next acquire
+        return;
+    }
+
+    uint32_t imageCount = std::max(requestedImageCount, capabilities.minImageCount);
+    if (capabilities.maxImageCount > 0)
+    {
+        imageCount = std::min(imageCount, capabilities.maxImageCount);
+    }
+
+    std::vector<vk::PresentModeKHR> presentModes = physicalDevice.getSurfacePresentModesKHR(surface);
+    activeMode = requestedMode;
+    if (std::find(presentModes.begin(), presentModes.end(), to_vulkan(requestedMode)) == presentModes.end())
+    {
+        RAY_LOG_INF << "Present mode " << vk::to_string(to_vulkan(requestedMode)) << " is unavailable, using FIFO";
+        activeMode = PresentMode::Fifo;
+    }
+
+    vk::SurfaceFormatKHR surfaceFormat = choose_surface_format(physicalDevice.getSurfaceFormatsKHR(surface));
+    format = surfaceFormat.format;
+
+    // transfers into the images are optional, rendering into them is not
+    if (!(capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eColorAttachment))
+    {
+        throw std::runtime_error("The surface does not support color attachment swapchain images!");
+    }
+    usage = (vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst) &
+            capabilities.supportedUsageFlags;
+
+    vk::SwapchainCreateInfoKHR createInfo = vk::SwapchainCreateInfoKHR(
+        vk::SwapchainCreateFlagsKHR(), surface, imageCount, surfaceFormat.format, surfaceFormat.colorSpace, extent, 1,
+        usage, vk::SharingMode::eExclusive, 0, nullptr, capabilities.currentTransform,
+        choose_composite_alpha(capabilities.supportedCompositeAlpha), to_vulkan(activeMode), VK_TRUE, swapchain);
+    vk::SwapchainKHR replacement = device.createSwapchainKHR(createInfo);
+
+    if (swapchain)
+    {
+        retired.push_back(Retired{swapchain, std::move(views), std::move(rendered), frameNumber});
+        views.clear();
+        rendered.clear();
+        std::lock_guard<std::mutex> lock(statsMutex);
+        counters.recreations++;
+    }
+    swapchain = replacement;
+    outOfDate = false;
+
+    images = device.getSwapchainImagesKHR(swapchain);
+    for (vk::Image image : images)
+    {
+        vk::ImageViewCreateInfo viewInfo = vk::ImageViewCreateInfo(
+            vk::ImageViewCreateFlags(), image, vk::ImageViewType::e2D, format, vk::ComponentMapping(),
+            vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+        views.push_back(device.createImageView(viewInfo));
+        rendered.push_back(device.createSemaphore(vk::SemaphoreCreateInfo()));
+    }
+
+    if (engine.is_debug())
+    {
+        RAY_LOG_INF << "Swapchain of " << images.size() << " images, " << extent.width << "x" << extent.height
+                    << ", " << vk::to_string(to_vulkan(activeMode));
+    }
+}
+
+void Swapchain::retire_unsubmitted(size_t slot)
+{
+    if (!unsubmitted[slot])
+    {
+        return;
+    }
+    // consume the pending acquire signal so the semaphore can be reused, and signal the fence
+    // in case a failed submit left it reset
+    const vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eAllCommands;
+    vk::SubmitInfo submitInfo = vk::SubmitInfo(1, &acquired[slot], &waitStage, 0, nullptr, 0, nullptr);
+    engine.get_device().resetFences(fences[slot]);
+    engine.submit(submitInfo, fences[slot]);
+    unsubmitted[slot] = false;
+}
+
+void Swapchain::release_retired(bool all)
+{
+    /*
+     * Frames numbered below retiredAt may use the retired swapchain. Acquiring frame n
+     * waits for frame n - framesInFlight, so once frameNumber reaches retiredAt plus the
+     * number of slots all of them have finished.
+     */
+    const vk::Device& device = engine.get_device();
+    auto              done = [&](const Retired& old) { return all || frameNumber >= old.retiredAt + fences.size(); };
+    for (Retired& old : retired)
+    {
+        if (!done(old))
+        {
+            continue;
+        }
+        for (vk::ImageView view : old.views)
+        {
+            device.destroyImageView(view);
+        }
+        for (vk::Semaphore semaphore : old.rendered)
+        {
+            device.destroySemaphore(semaphore);
+        }
+        device.destroySwapchainKHR(old.swapchain);
+    }
+    retired.erase(std::remove_if(retired.begin(), retired.end(), done), retired.end());
+}
+
+void Swapchain::record_present(std::chrono::steady_clock::time_point acquiredAt)
+{
+    const auto                  now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(statsMutex);
+
+    const double latency = std::chrono::duration<double>(now - acquiredAt).count();
+    latencySum += latency;
+    counters.maxFrameLatency = std::max(counters.maxFrameLatency, to_microseconds(latency));
+
+    if (counters.presents > 0)
+    {
+        // Welford's update, numerically stable over long CI runs
+        const double   interval = std::chrono::duration<double>(now - lastPresent).count();
+        const uint64_t intervals = counters.presents;
+        const double   delta = interval - intervalMean;
+        intervalMean += delta / static_cast<double>(intervals);
+        intervalM2 += delta * (interval - intervalMean);
+
+        const std::chrono::microseconds micros = to_microseconds(interval);
+        counters.minInterval = intervals == 1 ? micros : std::min(counters.minInterval, micros);
+        counters.maxInterval = std::max(counters.maxInterval, micros);
+    }
+    counters.presents++;
+    lastPresent = now;
+}
+} // namespace vtpl
@@ -0,0 +1,354 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "telemetry.h"
+#include "core_context.h"
+#include <algorithm>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <logging.h>
+#include <sstream>
+#include <utility>
+
+namespace vtpl
+{
+namespace
+{
+const char* const stageNames[stageCount] = {"upload", "composite", "readback"};
+
+double to_microseconds(uint64_t nanoseconds) { return static_cast<double>(nanoseconds) / 1000.0; }
+
+void write_stream_id(std::ostream& out, uint32_t stream)
+{
+    if (stream == Telemetry::allStreams)
+    {
+        out << "\"all\"";
+    }
+    else
+    {
+        out << stream;
+    }
+}
+
+/**
+    Write count, p50, p90, p99 and max of a histogram, in microseconds.
+*/
+void write_latency(std::ostream& out, const std::array<uint64_t, LatencyHistogram::bucketCount>& counts,
+                   uint64_t total)
+{
+    const double quantiles[3] = {0.5, 0.9, 0.99};
+    const char*  names[3] = {"p50_us", "p90_us", "p99_us"};
+
+    out << "{\"count\":" << total;
+    uint64_t seen = 0;
+    size_t   next = 0;
+    uint32_t highest = 0;
+    for (uint32_t i = 0; i < LatencyHistogram::bucketCount; i++)
+    {
+        if (counts[i] == 0)
+        {
+            continue;
+        }
+        seen += counts[i];
+        highest = i;
+        while (next < 3 && static_cast<double>(seen) >= quantiles[next] * static_cast<double>(total))
+        {
+            out << ",\"" << names[next] << "\":" << to_microseconds(LatencyHistogram::bucket_upper(i));
+            next++;
+        }
+    }
+    out << ",\"max_us\":" << to_microseconds(LatencyHistogram::bucket_upper(highest)) << '}';
+}
+} // namespace
+
+std::array<uint64_t, LatencyHistogram::bucketCount> LatencyHistogram::snapshot() const noexcept
+{
+    std::array<uint64_t, bucketCount> counts{};
+    for (uint32_t i = 0; i < bucketCount; i++)
+    {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+    return counts;
+}
+
+uint32_t LatencyHistogram::bucket_index(uint64_t nanoseconds) noexcept
+{
+    if (nanoseconds < subBuckets)
+    {
+        return static_cast<uint32_t>(nanoseconds);
+    }
+    const auto magnitude = static_cast<uint32_t>(std::bit_width(nanoseconds) - 1);
+    if (magnitude > maxMagnitude)
+    {
+        return bucketCount - 1;
+    }
+    // values of magnitude m >= 3 land in row m - 2, split on the 3 bits below the top one
+    const uint32_t shift = magnitude - 3;
+    return (shift + 1) * subBuckets + static_cast<uint32_t>((nanoseconds >> shift) & (subBuckets - 1));
+}
+
+uint64_t LatencyHistogram::bucket_upper(uint32_t index) noexcept
+{
+    if (index < subBuckets)
+    {
+        return index;
+    }
+    const uint32_t shift = index / subBuckets - 1;
+    const uint64_t lower = static_cast<uint64_t>(subBuckets + index % subBuckets) << shift;
+    return lower + (uint64_t(1) << shift) - 1;
+}
+
+thread_local Telemetry::ThreadData* Telemetry::localThread = nullptr;
+thread_local uint32_t               Telemetry::localStream = 0;
+thread_local Telemetry::StreamData* Telemetry::localData = nullptr;
+thread_local uint32_t               Telemetry::localDepthStream = 0;
+thread_local Telemetry::QueueDepth* Telemetry::localDepth = nullptr;
+
+Telemetry& Telemetry::instance()
+{
+    static Telemetry s_instance;
+    return s_instance;
+}
+
+Telemetry::~Telemetry() { stop_export(); }
+
+void Telemetry::record(uint32_t stream, Stage stage, std::chrono::nanoseconds latency)
+{
+    const auto nanoseconds = static_cast<uint64_t>(latency.count() > 0 ? latency.count() : 0);
+    local_stream(stream).stages[static_cast<size_t>(stage)].record(nanoseconds);
+}
+
+void Telemetry::count_dropped(uint32_t stream, uint64_t frames)
+{
+    std::atomic<uint64_t>& dropped = local_stream(stream).dropped;
+    dropped.store(dropped.load(std::memory_order_relaxed) + frames, std::memory_order_relaxed);
+}
+
+void Telemetry::set_queue_depth(uint32_t stream, uint64_t depth)
+{
+    QueueDepth& queueDepth = queue_depth(stream);
+    queueDepth.current.store(depth, std::memory_order_relaxed);
+    uint64_t peak = queueDepth.peak.load(std::memory_order_relaxed);
+    while (depth > peak && !queueDepth.peak.compare_exchange_weak(peak, depth, std::memory_order_relaxed))
+    {
+    }
+}
+
+void Telemetry::start_export(std::chrono::milliseconds interval, const std::string& fileName)
+{
+    stop_export();
+
+    const std::filesystem::path folder(CoreContext::instance().get_session_folder());
+    std::filesystem::create_directories(folder);
+    {
+        std::lock_guard<std::mutex> lock(exportMutex);
+        exportPath = (folder / fileName).string();
+        exportStopping = false;
+    }
+
+    exportThread = std::thread(
+        [this, interval]()
+        {
+            std::unique_lock<std::mutex> lock(exportMutex);
+            while (!exportWakeup.wait_for(lock, interval, [this] { return exportStopping; }))
+            {
+                lock.unlock();
+                export_now();
+                lock.lock();
+            }
+        });
+}
+
+void Telemetry::stop_export()
+{
+    {
+        std::lock_guard<std::mutex> lock(exportMutex);
+        exportStopping = true;
+    }
+    exportWakeup.notify_all();
+    if (exportThread.joinable())
+    {
+        exportThread.join();
+        export_now();
+    }
+}
+
+void Telemetry::export_now()
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(exportMutex);
+        path = exportPath;
+    }
+    if (path.empty())
+    {
+        return;
+    }
+
+    // current and peak of every stream which reported a queue depth
+    std::map<uint32_t, std::pair<uint64_t, uint64_t>> depths;
+    {
+        std::shared_lock<std::shared_mutex> lock(depthMutex);
+        for (auto& [stream, queueDepth] : queueDepths)
+        {
+            const uint64_t current = queueDepth->current.load(std::memory_order_relaxed);
+            const uint64_t peak = queueDepth->peak.exchange(current, std::memory_order_relaxed);
+            depths[stream] = {current, std::max(peak, current)};
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // merge the threads into per stream totals
+    std::map<uint32_t, Exported> totals;
+    for (const std::unique_ptr<ThreadData>& thread : threads)
+    {
+        for (const auto& [stream, data] : thread->streams)
+        {
+            Exported& total = totals[stream];
+            for (size_t stage = 0; stage < stageCount; stage++)
+            {
+                const auto counts = data->stages[stage].snapshot();
+                for (uint32_t i = 0; i < LatencyHistogram::bucketCount; i++)
+                {
+                    total.stages[stage][i] += counts[i];
+                }
+            }
+            total.dropped += data->dropped.load(std::memory_order_relaxed);
+        }
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto wallClock = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastExport);
+    lastExport = now;
+
+    std::ostringstream line;
+    line << "{\"time_ms\":" << wallClock.count() << ",\"interval_ms\":" << elapsed.count() << ",\"streams\":[";
+    bool firstStream = true;
+    for (auto& [stream, total] : totals)
+    {
+        Exported& previous = exported[stream];
+
+        // only what changed during the interval is written, idle streams are left out
+        std::ostringstream fields;
+        if (total.dropped != previous.dropped)
+        {
+            fields << ",\"dropped\":" << total.dropped - previous.dropped;
+        }
+        auto depth = depths.find(stream);
+        if (depth != depths.end())
+        {
+            fields << ",\"queue_depth\":" << depth->second.first << ",\"queue_depth_peak\":" << depth->second.second;
+            depths.erase(depth);
+        }
+        for (size_t stage = 0; stage < stageCount; stage++)
+        {
+            std::array<uint64_t, LatencyHistogram::bucketCount> delta{};
+            uint64_t                                            count = 0;
+            for (uint32_t i = 0; i < LatencyHistogram::bucketCount; i++)
+            {
+                delta[i] = total.stages[stage][i] - previous.stages[stage][i];
+                count += delta[i];
+            }
+            if (count > 0)
+            {
+                fields << ",\"" << stageNames[stage] << "\":";
+                write_latency(fields, delta, count);
+            }
+        }
+        previous = total;
+
+        const std::string text = fields.str();
+        if (!text.empty())
+        {
+            line << (firstStream ? "" : ",") << "{\"stream\":";
+            firstStream = false;
+            write_stream_id(line, stream);
+            line << text << '}';
+        }
+    }
+    // streams which only reported a queue depth
+    for (const auto& [stream, queueDepth] : depths)
+    {
+        line << (firstStream ? "" : ",") << "{\"stream\":";
+        firstStream = false;
+        write_stream_id(line, stream);
+        line << ",\"queue_depth\":" << queueDepth.first << ",\"queue_depth_peak\":" << queueDepth.second << '}';
+    }
+    line << "]}\n";
+
+    // one write per line, so a tailing reader never sees half of one
+    std::ofstream file(path, std::ios::app);
+    if (!file)
+    {
+        RAY_LOG_ERR << "Failed to open telemetry file \"" << path << "\"";
+        return;
+    }
+    const std::string text = line.str();
+    file.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+Telemetry::StreamData& Telemetry::local_stream(uint32_t stream)
+{
+    if (localData != nullptr && localStream == stream)
+    {
+        return *localData;
+    }
+
+    ThreadData* thread = localThread;
+    if (thread == nullptr)
+    {
+        // owned by the telemetry so the samples outlive the thread
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.push_back(std::make_unique<ThreadData>());
+        thread = threads.back().get();
+        localThread = thread;
+    }
+
+    auto found = thread->streams.find(stream);
+    if (found == thread->streams.end())
+    {
+        // the export thread walks the map, so insertions are made under its lock
+        std::lock_guard<std::mutex> lock(mutex);
+        found = thread->streams.emplace(stream, std::make_unique<StreamData>()).first;
+    }
+    localStream = stream;
+    localData = found->second.get();
+    return *localData;
+}
+
+Telemetry::QueueDepth& Telemetry::queue_depth(uint32_t stream)
+{
+    if (localDepth != nullptr && localDepthStream == stream)
+    {
+        return *localDepth;
+    }
+
+    QueueDepth* queueDepth = nullptr;
+    {
+        std::shared_lock<std::shared_mutex> lock(depthMutex);
+        auto                                found = queueDepths.find(stream);
+        if (found != queueDepths.end())
+        {
+            queueDepth = found->second.get();
+        }
+    }
+    if (queueDepth == nullptr)
+    {
+        std::unique_lock<std::shared_mutex> lock(depthMutex);
+        std::unique_ptr<QueueDepth>&        slot = queueDepths[stream];
+        if (!slot)
+        {
+            slot = std::make_unique<QueueDepth>();
+        }
+        queueDepth = slot.get();
+    }
+    localDepthStream = stream;
+    localDepth = queueDepth;
+    return *queueDepth;
+}
+} // namespace vtpl
@@ -0,0 +1,581 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "trace_replay.h"
+#include "pipeline.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <logging.h>
+#include <stdexcept>
+
+namespace vtpl
+{
+namespace
+{
+// filler payloads start at one of this many offsets into the filler, picked by their hash
+constexpr uint64_t fillerSpread = 4096;
+
+// vkCmdUpdateBuffer limits, smaller stored uploads to device local buffers skip staging
+constexpr uint64_t maxUpdateSize = 65536;
+} // namespace
+
+TraceReplay::TraceReplay(Engine& engine, const std::string& path) : engine(engine)
+{
+    const vk::Device& device = engine.get_device();
+
+    // decode everything up front so file access is not part of the timings
+    TraceReader reader(path);
+    TraceRecord record;
+    uint64_t    largestUpload = 0;
+    uint32_t    sets = 0;
+    uint32_t    bindings = 0;
+    uint32_t    samplers = 0;
+    uint32_t    maxSets = 1;
+    uint32_t    maxBindings = 1;
+    uint32_t    maxSamplers = 1;
+    while (reader.next(record))
+    {
+        switch (record.op)
+        {
+        case TraceOp::Upload:
+            largestUpload = std::max(largestUpload, record.size);
+            break;
+        case TraceOp::Dispatch:
+        case TraceOp::Draw:
+            sets++;
+            bindings += static_cast<uint32_t>(record.bindings.size());
+            samplers += record.op == TraceOp::Draw ? 1 : 0;
+            maxSets = std::max(maxSets, sets);
+            maxBindings = std::max(maxBindings, bindings);
+            maxSamplers = std::max(maxSamplers, samplers);
+            break;
+        case TraceOp::Submit:
+            sets = 0;
+            bindings = 0;
+            samplers = 0;
+            break;
+        case TraceOp::Frame:
+            hasFrames = true;
+            break;
+        default:
+            break;
+        }
+        records.push_back(std::move(record));
+    }
+
+    // a fixed pseudo random pattern, so every run uploads exactly the same bytes
+    filler.resize(static_cast<size_t>(largestUpload + fillerSpread));
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (uint8_t& byte : filler)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        byte = static_cast<uint8_t>(state);
+    }
+
+    // at most one set per dispatch and draw of a submission, the pool is reset after each one
+    std::array<vk::DescriptorPoolSize, 2> poolSizes = {
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, maxBindings),
+        vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, maxSamplers)};
+    descriptorPool = device.createDescriptorPool(vk::DescriptorPoolCreateInfo(
+        vk::DescriptorPoolCreateFlags(), maxSets, static_cast<uint32_t>(poolSizes.size()), poolSizes.data()));
+
+    vk::SamplerCreateInfo samplerInfo = vk::SamplerCreateInfo(
+        vk::SamplerCreateFlags(), vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eNearest,
+        vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge,
+        vk::SamplerAddressMode::eClampToEdge);
+    sampler = device.createSampler(samplerInfo);
+
+    // a pool of its own, the engine pool belongs to immediate_submit
+    commandPool = device.createCommandPool(vk::CommandPoolCreateInfo(
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer, engine.get_queue_family_index()));
+    vk::CommandBufferAllocateInfo allocInfo =
+        vk::CommandBufferAllocateInfo(commandPool, vk::CommandBufferLevel::ePrimary, 1);
+    commandBuffer = device.allocateCommandBuffers(allocInfo)[0];
+    fence = device.createFence(vk::FenceCreateInfo());
+
+    for (const TraceRecord& traced : records)
+    {
+        if (traced.op == TraceOp::Dispatch)
+        {
+            (void)compute(traced);
+        }
+        else if (traced.op == TraceOp::Draw)
+        {
+            (void)graphics(traced);
+        }
+    }
+
+    if (engine.is_debug())
+    {
+        RAY_LOG_INF << "Loaded command trace \"" << path << "\" with " << records.size() << " records";
+    }
+}
+
+TraceReplay::~TraceReplay()
+{
+    const vk::Device& device = engine.get_device();
+    device.waitIdle();
+
+    for (auto& [name, pipeline] : pipelines)
+    {
+        device.destroyPipeline(pipeline.pipeline);
+        device.destroyPipelineLayout(pipeline.layout);
+        device.destroyDescriptorSetLayout(pipeline.setLayout);
+    }
+    for (auto& [name, pipeline] : graphicsPipelines)
+    {
+        device.destroyPipeline(pipeline.pipeline);
+        device.destroyRenderPass(pipeline.renderPass);
+        device.destroyPipelineLayout(pipeline.layout);
+        device.destroyDescriptorSetLayout(pipeline.setLayout);
+    }
+    device.destroyFence(fence);
+    device.destroyCommandPool(commandPool);
+    device.destroyDescriptorPool(descriptorPool);
+    device.destroySampler(sampler);
+}
+
+ReplayStats TraceReplay::run()
+{
+    ReplayStats stats;
+    auto        frameStart = std::chrono::steady_clock::now();
+    auto        end_frame = [&]()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        stats.frameTimes.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(now - frameStart));
+        frameStart = now;
+    };
+
+    for (const TraceRecord& record : records)
+    {
+        switch (record.op)
+        {
+        case TraceOp::CreateBuffer:
+        case TraceOp::CreateImage:
+            create(record);
+            break;
+        case TraceOp::Destroy:
+            destroy(record.id);
+            break;
+        case TraceOp::Upload:
+            upload(record, stats);
+            break;
+        case TraceOp::CopyToImage:
+            copy(record, stats);
+            break;
+        case TraceOp::Dispatch:
+            dispatch(record, stats);
+            break;
+        case TraceOp::Draw:
+            draw(record, stats);
+            break;
+        case TraceOp::Submit:
+            stats.submits++;
+            flush();
+            if (!hasFrames)
+            {
+                end_frame();
+            }
+            break;
+        case TraceOp::Frame:
+            flush();
+            end_frame();
+            break;
+        }
+    }
+    flush();
+
+    // resources still alive at the end of the recording
+    while (!buffers.empty())
+    {
+        destroy(buffers.begin()->first);
+    }
+    while (!images.empty())
+    {
+        destroy(images.begin()->first);
+    }
+    return stats;
+}
+
+void TraceReplay::create(const TraceRecord& record)
+{
+    if (record.op == TraceOp::CreateBuffer)
+    {
+        // uploads to device local buffers are replayed as transfers
+        const vk::BufferUsageFlags usage =
+            vk::BufferUsageFlags(record.usage) | vk::BufferUsageFlagBits::eTransferDst;
+        buffers[record.id] = make_buffer(engine, record.size, usage, vk::MemoryPropertyFlags(record.properties));
+        return;
+    }
+    const vk::ImageUsageFlags usage = vk::ImageUsageFlags(record.usage) | vk::ImageUsageFlagBits::eTransferDst;
+    Image& image = images[record.id] =
+        record.arrayLayers > 1 ? make_image_array(engine, record.extent, record.format, usage, record.arrayLayers)
+                               : make_image(engine, record.extent, record.format, usage, record.mipLevels);
+
+    // the general layout suits transfers, sampling and drawing, so no command has to track layouts
+    begin();
+    transition_image(commandBuffer, image, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral);
+}
+
+void TraceReplay::destroy(uint32_t id)
+{
+    if (recording)
+    {
+        // still referenced by the commands being recorded
+        pendingDestroys.push_back(id);
+        return;
+    }
+    auto buffer = buffers.find(id);
+    if (buffer != buffers.end())
+    {
+        destroy_buffer(engine, buffer->second);
+        buffers.erase(buffer);
+        return;
+    }
+    auto framebuffer = framebuffers.find(id);
+    if (framebuffer != framebuffers.end())
+    {
+        engine.get_device().destroyFramebuffer(framebuffer->second);
+        framebuffers.erase(framebuffer);
+    }
+    auto image = images.find(id);
+    if (image != images.end())
+    {
+        destroy_image(engine, image->second);
+        images.erase(image);
+    }
+}
+
+void TraceReplay::upload(const TraceRecord& record, ReplayStats& stats)
+{
+    if (record.size == 0)
+    {
+        return;
+    }
+    const uint8_t* data = payload(record);
+    const size_t   size = static_cast<size_t>(record.size);
+
+    auto buffer = buffers.find(record.id);
+    if (buffer != buffers.end())
+    {
+        Buffer& destination = buffer->second;
+        if (record.offset + record.size > destination.size)
+        {
+            return;
+        }
+        if (destination.mapped != nullptr)
+        {
+            std::memcpy(static_cast<uint8_t*>(destination.mapped) + record.offset, data, size);
+        }
+        else if (!record.data.empty() && record.offset % 4 == 0 && size % 4 == 0 && size <= maxUpdateSize)
+        {
+            begin();
+            commandBuffer.updateBuffer(destination.buffer, record.offset, size, data);
+        }
+        else
+        {
+            Buffer staging = make_buffer(
+                engine, record.size, vk::BufferUsageFlagBits::eTransferSrc,
+                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+            std::memcpy(staging.mapped, data, size);
+            begin();
+            commandBuffer.copyBuffer(staging.buffer, destination.buffer,
+                                     vk::BufferCopy(0, record.offset, record.size));
+            stagingBuffers.push_back(staging);
+        }
+        stats.uploads++;
+        stats.uploadedBytes += record.size;
+        return;
+    }
+
+    auto image = images.find(record.id);
+    if (image != images.end())
+    {
+        // the base level of the first layer, like upload_image
+        Buffer staging =
+            make_buffer(engine, record.size, vk::BufferUsageFlagBits::eTransferSrc,
+                        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+        std::memcpy(staging.mapped, data, size);
+        begin();
+        barrier();
+        vk::BufferImageCopy region = vk::BufferImageCopy(
+            0, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), vk::Offset3D(0, 0, 0),
+            vk::Extent3D(image->second.extent.width, image->second.extent.height, 1));
+        commandBuffer.copyBufferToImage(staging.buffer, image->second.image, vk::ImageLayout::eGeneral, region);
+        stagingBuffers.push_back(staging);
+        stats.uploads++;
+        stats.uploadedBytes += record.size;
+    }
+}
+
+void TraceReplay::copy(const TraceRecord& record, ReplayStats& stats)
+{
+    auto buffer = buffers.find(record.id);
+    auto image = images.find(record.target);
+    if (buffer == buffers.end() || image == images.end())
+    {
+        stats.skipped++;
+        return;
+    }
+    begin();
+    barrier();
+    commandBuffer.copyBufferToImage(buffer->second.buffer, image->second.image, vk::ImageLayout::eGeneral,
+                                    record.regions);
+    stats.copies++;
+}
+
+void TraceReplay::dispatch(const TraceRecord& record, ReplayStats& stats)
+{
+    std::vector<vk::DescriptorBufferInfo> bufferInfos;
+    for (uint32_t id : record.bindings)
+    {
+        auto buffer = buffers.find(id);
+        if (buffer == buffers.end())
+        {
+            stats.skipped++;
+            return;
+        }
+        bufferInfos.emplace_back(buffer->second.buffer, 0, VK_WHOLE_SIZE);
+    }
+
+    Compute&          pipeline = compute(record);
+    const vk::Device& device = engine.get_device();
+
+    vk::DescriptorSet descriptorSet =
+        device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(descriptorPool, 1, &pipeline.setLayout))[0];
+    std::vector<vk::WriteDescriptorSet> writes;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(bufferInfos.size()); i++)
+    {
+        writes.emplace_back(descriptorSet, i, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos[i]);
+    }
+    device.updateDescriptorSets(writes, nullptr);
+
+    begin();
+
+    // the trace has no dependencies, so every dispatch waits for all earlier transfers and dispatches
+    vk::MemoryBarrier barrier = vk::MemoryBarrier(
+        vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderWrite,
+        vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+                                  vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), barrier, nullptr,
+                                  nullptr);
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline.pipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline.layout, 0, descriptorSet, nullptr);
+    if (!record.pushConstants.empty())
+    {
+        commandBuffer.pushConstants(pipeline.layout, vk::ShaderStageFlagBits::eCompute, 0,
+                                    static_cast<uint32_t>(record.pushConstants.size()), record.pushConstants.data());
+    }
+    commandBuffer.dispatch(record.groups[0], record.groups[1], record.groups[2]);
+    stats.dispatches++;
+}
+
+void TraceReplay::draw(const TraceRecord& record, ReplayStats& stats)
+{
+    auto target = images.find(record.target);
+    auto sampled = images.find(record.sampled);
+    if (target == images.end() || sampled == images.end())
+    {
+        stats.skipped++;
+        return;
+    }
+    std::vector<vk::DescriptorBufferInfo> bufferInfos;
+    for (uint32_t id : record.bindings)
+    {
+        auto buffer = buffers.find(id);
+        if (buffer == buffers.end())
+        {
+            stats.skipped++;
+            return;
+        }
+        bufferInfos.emplace_back(buffer->second.buffer, 0, VK_WHOLE_SIZE);
+    }
+
+    Graphics&          pipeline = graphics(record);
+    const vk::Device&  device = engine.get_device();
+    const vk::Extent2D extent = target->second.extent;
+
+    vk::Framebuffer& framebuffer = framebuffers[record.target];
+    if (!framebuffer)
+    {
+        vk::FramebufferCreateInfo framebufferInfo = vk::FramebufferCreateInfo(
+            vk::FramebufferCreateFlags(), pipeline.renderPass, 1, &target->second.view, extent.width, extent.height, 1);
+        framebuffer = device.createFramebuffer(framebufferInfo);
+    }
+
+    vk::DescriptorSet descriptorSet =
+        device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(descriptorPool, 1, &pipeline.setLayout))[0];
+    const auto              samplerBinding = static_cast<uint32_t>(bufferInfos.size());
+    vk::DescriptorImageInfo imageInfo =
+        vk::DescriptorImageInfo(sampler, sampled->second.view, vk::ImageLayout::eGeneral);
+    std::vector<vk::WriteDescriptorSet> writes;
+    for (uint32_t i = 0; i < samplerBinding; i++)
+    {
+        writes.emplace_back(descriptorSet, i, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos[i]);
+    }
+    writes.emplace_back(descriptorSet, samplerBinding, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfo);
+    device.updateDescriptorSets(writes, nullptr);
+
+    begin();
+    barrier();
+    vk::RenderPassBeginInfo renderPassInfo = vk::RenderPassBeginInfo(
+        pipeline.renderPass, framebuffer, vk::Rect2D(vk::Offset2D(0, 0), extent), 0, nullptr);
+    commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+    if (record.instanceCount > 0)
+    {
+        commandBuffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(extent.width),
+                                                  static_cast<float>(extent.height), 0.0f, 1.0f));
+        commandBuffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), extent));
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.pipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline.layout, 0, descriptorSet,
+                                         nullptr);
+        if (!record.pushConstants.empty())
+        {
+            commandBuffer.pushConstants(pipeline.layout,
+                                        vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0,
+                                        static_cast<uint32_t>(record.pushConstants.size()),
+                                        record.pushConstants.data());
+        }
+        commandBuffer.draw(record.vertexCount, record.instanceCount, 0, 0);
+        stats.draws++;
+    }
+    commandBuffer.endRenderPass();
+}
+
+void TraceReplay::flush()
+{
+    if (!recording)
+    {
+        return;
+    }
+    const vk::Device& device = engine.get_device();
+
+    commandBuffer.end();
+    vk::SubmitInfo submitInfo = vk::SubmitInfo(0, nullptr, nullptr, 1, &commandBuffer);
+    engine.submit(submitInfo, fence);
+    (void)device.waitForFences(fence, VK_TRUE, UINT64_MAX);
+    device.resetFences(fence);
+    device.resetDescriptorPool(descriptorPool);
+    recording = false;
+
+    for (Buffer& staging : stagingBuffers)
+    {
+        destroy_buffer(engine, staging);
+    }
+    stagingBuffers.clear();
+
+    std::vector<uint32_t> destroys;
+    destroys.swap(pendingDestroys);
+    for (uint32_t id : destroys)
+    {
+        destroy(id);
+    }
+}
+
+TraceReplay::Compute& TraceReplay::compute(const TraceRecord& record)
+{
+    const std::string key = record.shader + "/" + std::to_string(record.bindings.size()) + "/" +
+                            std::to_string(record.pushConstants.size());
+    auto found = pipelines.find(key);
+    if (found != pipelines.end())
+    {
+        return found->second;
+    }
+
+    const vk::Device& device = engine.get_device();
+    Compute           pipeline;
+
+    std::vector<vk::DescriptorSetLayoutBinding> bindings;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(record.bindings.size()); i++)
+    {
+        bindings.emplace_back(i, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
+    }
+    pipeline.setLayout = device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo(
+        vk::DescriptorSetLayoutCreateFlags(), static_cast<uint32_t>(bindings.size()), bindings.data()));
+
+    vk::PushConstantRange pushConstantRange = vk::PushConstantRange(
+        vk::ShaderStageFlagBits::eCompute, 0, static_cast<uint32_t>(record.pushConstants.size()));
+    pipeline.layout = device.createPipelineLayout(
+        vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(), 1, &pipeline.setLayout,
+                                     record.pushConstants.empty() ? 0 : 1, &pushConstantRange));
+    pipeline.pipeline = make_compute_pipeline(device, pipeline.layout, record.shader, engine.is_debug());
+
+    return pipelines.emplace(key, pipeline).first->second;
+}
+
+TraceReplay::Graphics& TraceReplay::graphics(const TraceRecord& record)
+{
+    const std::string key = record.shader + "/" + record.fragmentShader + "/" +
+                            std::to_string(record.bindings.size()) + "/" +
+                            std::to_string(record.pushConstants.size()) + "/" +
+                            std::to_string(static_cast<uint32_t>(record.format));
+    auto found = graphicsPipelines.find(key);
+    if (found != graphicsPipelines.end())
+    {
+        return found->second;
+    }
+
+    const vk::Device&          device = engine.get_device();
+    const vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+    Graphics                   pipeline;
+
+    std::vector<vk::DescriptorSetLayoutBinding> bindings;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(record.bindings.size()); i++)
+    {
+        bindings.emplace_back(i, vk::DescriptorType::eStorageBuffer, 1, stages);
+    }
+    bindings.emplace_back(static_cast<uint32_t>(record.bindings.size()), vk::DescriptorType::eCombinedImageSampler,
+                          1, vk::ShaderStageFlagBits::eFragment);
+    pipeline.setLayout = device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo(
+        vk::DescriptorSetLayoutCreateFlags(), static_cast<uint32_t>(bindings.size()), bindings.data()));
+
+    vk::PushConstantRange pushConstantRange =
+        vk::PushConstantRange(stages, 0, static_cast<uint32_t>(record.pushConstants.size()));
+    pipeline.layout = device.createPipelineLayout(
+        vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(), 1, &pipeline.setLayout,
+                                     record.pushConstants.empty() ? 0 : 1, &pushConstantRange));
+
+    // the target keeps its contents like the wall does, and stays in the general layout
+    pipeline.renderPass =
+        make_color_render_pass(device, record.format, vk::ImageLayout::eGeneral, vk::AttachmentLoadOp::eLoad);
+    pipeline.pipeline = make_graphics_pipeline(device, pipeline.layout, pipeline.renderPass, record.shader,
+                                               record.fragmentShader, engine.is_debug());
+
+    return graphicsPipelines.emplace(key, pipeline).first->second;
+}
+
+void TraceReplay::begin()
+{
+    if (!recording)
+    {
+        commandBuffer.reset();
+        commandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        recording = true;
+    }
+}
+
+void TraceReplay::barrier()
+{
+    // the trace has no dependencies, so copies and draws wait for all earlier commands
+    vk::MemoryBarrier memoryBarrier = vk::MemoryBarrier(
+        vk::AccessFlagBits::eMemoryWrite, vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eAllCommands,
+                                  vk::DependencyFlags(), memoryBarrier, nullptr, nullptr);
+}
+
+const uint8_t* TraceReplay::payload(const TraceRecord& record) const
+{
+    if (!record.data.empty())
+    {
+        return record.data.data();
+    }
+    // equal payloads hash equal and get the same filler, different ones most likely do not
+    const uint64_t seed = record.hash != 0 ? record.hash : (static_cast<uint64_t>(record.id) << 32) ^ record.offset;
+    return filler.data() + (seed % fillerSpread & ~uint64_t(3));
+}
+} // namespace vtpl
@@ -0,0 +1,415 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "wall_compositor.h"
+#include "command_trace.h"
+#include "pipeline.h"
+#include "telemetry.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <logging.h>
+
+namespace vtpl
+{
+namespace
+{
+constexpr vk::DeviceSize bytesPerTexel = 4;
+constexpr size_t         initialTileCapacity = 64;
+
+// push constants of compositor.vert
+struct CompositeParams
+{
+    float targetWidth;
+    float targetHeight;
+};
+} // namespace
+
+WallCompositor::WallCompositor(Engine& engine, uint32_t width, uint32_t height, uint32_t streamCount,
+                               vk::Extent2D streamExtent, uint32_t stagingSlices)
+    : engine(engine), width(width), height(height), streamCount(streamCount), streamExtent(streamExtent),
+      streamFrames(streamCount, 0), pendingUploads(streamCount, false), stagingSlice(streamCount, 0),
+      stagingSlices(std::clamp(stagingSlices, 1U, std::max(streamCount, 1U)))
+{
+    const vk::Device&             device = engine.get_device();
+    const vk::MemoryPropertyFlags hostVisible =
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+    const vk::DeviceSize layerSize = bytesPerTexel * streamExtent.width * streamExtent.height;
+
+    if (engine.is_debug())
+    {
+        RAY_LOG_INF << "Making a wall compositor " << width << "x" << height << " for " << streamCount
+                    << " streams of " << streamExtent.width << "x" << streamExtent.height;
+    }
+
+    stagingBuffer =
+        make_buffer(engine, layerSize * this->stagingSlices, vk::BufferUsageFlagBits::eTransferSrc, hostVisible);
+    readbackBuffer = make_buffer(engine, bytesPerTexel * width * height, vk::BufferUsageFlagBits::eTransferDst,
+                                 hostVisible);
+
+    streamImages = make_image_array(engine, streamExtent, vk::Format::eR8G8B8A8Unorm,
+                                    vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+                                    streamCount);
+    target = make_image(engine, vk::Extent2D(width, height), vk::Format::eR8G8B8A8Unorm,
+                        vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc |
+                            vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
+
+    // streams show black until their first frame arrives
+    engine.immediate_submit(
+        [&](vk::CommandBuffer cmd)
+        {
+            const vk::ClearColorValue black = vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f});
+            transition_image(cmd, streamImages, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+            cmd.clearColorImage(streamImages.image, vk::ImageLayout::eTransferDstOptimal, black,
+                                vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, streamCount));
+            transition_image(cmd, streamImages, vk::ImageLayout::eTransferDstOptimal,
+                             vk::ImageLayout::eShaderReadOnlyOptimal);
+            transition_image(cmd, target, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferSrcOptimal);
+        });
+
+    vk::SamplerCreateInfo samplerInfo = vk::SamplerCreateInfo(
+        vk::SamplerCreateFlags(), vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eNearest,
+        vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge,
+        vk::SamplerAddressMode::eClampToEdge);
+    sampler = device.createSampler(samplerInfo);
+
+    make_descriptors();
+    ensure_tile_capacity(initialTileCapacity);
+    make_pipeline();
+
+    // a pool of its own, command pools must not be used from two threads at once
+    commandPool = device.createCommandPool(vk::CommandPoolCreateInfo(
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer, engine.get_queue_family_index()));
+    vk::CommandBufferAllocateInfo allocInfo =
+        vk::CommandBufferAllocateInfo(commandPool, vk::CommandBufferLevel::ePrimary, 1);
+    commandBuffer = device.allocateCommandBuffers(allocInfo)[0];
+    fence = device.createFence(vk::FenceCreateInfo());
+}
+
+WallCompositor::~WallCompositor()
+{
+    const vk::Device& device = engine.get_device();
+
+    device.destroyFence(fence);
+    device.destroyCommandPool(commandPool);
+    device.destroyPipeline(pipeline);
+    device.destroyPipelineLayout(pipelineLayout);
+    device.destroyFramebuffer(framebuffer);
+    device.destroyRenderPass(renderPass);
+    device.destroyDescriptorPool(descriptorPool);
+    device.destroyDescriptorSetLayout(descriptorSetLayout);
+    device.destroySampler(sampler);
+
+    destroy_image(engine, target);
+    destroy_image(engine, streamImages);
+    destroy_buffer(engine, readbackBuffer);
+    destroy_buffer(engine, stagingBuffer);
+    destroy_buffer(engine, drawListBuffer);
+    destroy_buffer(engine, tileBuffer);
+}
+
+bool WallCompositor::set_layout(const std::vector<WallTile>& layout)
+{
+    for (const WallTile& tile : layout)
+    {
+        if (tile.stream >= streamCount)
+        {
+            RAY_LOG_ERR << "Wall tile refers to stream " << tile.stream << " of " << streamCount;
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ensure_tile_capacity(layout.size());
+    auto* gpuTiles = static_cast<GpuTile*>(tileBuffer.mapped);
+    for (size_t i = 0; i < layout.size(); i++)
+    {
+        const TileViewport& v = layout[i].viewport;
+        gpuTiles[i] = GpuTile{{v.x, v.y, v.width, v.height}, layout[i].stream, {0, 0, 0}};
+    }
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        // the tile table decides where and what the draws sample, so it is kept verbatim
+        trace->upload(tileBuffer.buffer, 0, gpuTiles, layout.size() * sizeof(GpuTile), true);
+    }
+
+    tiles = layout;
+    tileFrames.assign(tiles.size(), 0);
+    layoutChanged = true;
+    return true;
+}
+
+bool WallCompositor::update_stream(uint32_t stream, const uint8_t* rgba)
+{
+    if (stream >= streamCount)
+    {
+        return false;
+    }
+    StageTimer                  timer(stream, Stage::Upload);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pendingUploads[stream])
+    {
+        // the previous frame of this stream is overwritten before it was ever composited
+        Telemetry::instance().count_dropped(stream);
+    }
+    else
+    {
+        if (usedSlices == stagingSlices)
+        {
+            flush_uploads();
+        }
+        stagingSlice[stream] = usedSlices++;
+        Telemetry::instance().set_queue_depth(stream, 1);
+    }
+    const vk::DeviceSize layerSize = bytesPerTexel * streamExtent.width * streamExtent.height;
+    const vk::DeviceSize offset = layerSize * stagingSlice[stream];
+    std::memcpy(static_cast<uint8_t*>(stagingBuffer.mapped) + offset, rgba, static_cast<size_t>(layerSize));
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        trace->upload(stagingBuffer.buffer, offset, rgba, layerSize);
+    }
+    pendingUploads[stream] = true;
+    streamFrames[stream]++;
+    return true;
+}
+
+uint32_t WallCompositor::composite()
+{
+    StageTimer                  timer(Telemetry::allStreams, Stage::Composite);
+    const vk::Device&           device = engine.get_device();
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // only tiles whose stream moved on since they were last drawn go into the draw list
+    auto*    drawList = static_cast<uint32_t*>(drawListBuffer.mapped);
+    uint32_t drawCount = 0;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(tiles.size()); i++)
+    {
+        const uint64_t frame = streamFrames[tiles[i].stream];
+        if (layoutChanged || tileFrames[i] != frame)
+        {
+            drawList[drawCount++] = i;
+            tileFrames[i] = frame;
+        }
+    }
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        trace->upload(drawListBuffer.buffer, 0, drawList, sizeof(uint32_t) * drawCount, true);
+    }
+
+    commandBuffer.reset();
+    record(commandBuffer, drawCount);
+
+    vk::SubmitInfo submitInfo = vk::SubmitInfo(0, nullptr, nullptr, 1, &commandBuffer);
+    engine.submit(submitInfo, fence);
+    (void)device.waitForFences(fence, VK_TRUE, UINT64_MAX);
+    device.resetFences(fence);
+
+    layoutChanged = false;
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        trace->frame();
+    }
+    return drawCount;
+}
+
+std::vector<uint8_t> WallCompositor::readback() const
+{
+    StageTimer                  timer(Telemetry::allStreams, Stage::Readback);
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto*                 pixels = static_cast<const uint8_t*>(readbackBuffer.mapped);
+    return std::vector<uint8_t>(pixels, pixels + readbackBuffer.size);
+}
+
+void WallCompositor::ensure_tile_capacity(size_t count)
+{
+    if (tileBuffer.buffer && tileBuffer.size >= count * sizeof(GpuTile))
+    {
+        return;
+    }
+
+    // composite() waits for its fence, so the old buffers are no longer in use
+    size_t capacity = initialTileCapacity;
+    while (capacity < count)
+    {
+        capacity *= 2;
+    }
+    if (tileBuffer.buffer)
+    {
+        destroy_buffer(engine, tileBuffer);
+        destroy_buffer(engine, drawListBuffer);
+    }
+
+    const vk::MemoryPropertyFlags hostVisible =
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+    tileBuffer = make_buffer(engine, sizeof(GpuTile) * capacity, vk::BufferUsageFlagBits::eStorageBuffer, hostVisible);
+    drawListBuffer =
+        make_buffer(engine, sizeof(uint32_t) * capacity, vk::BufferUsageFlagBits::eStorageBuffer, hostVisible);
+    write_buffer_descriptors();
+}
+
+void WallCompositor::make_descriptors()
+{
+    const vk::Device& device = engine.get_device();
+
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindings = {
+        vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex),
+        vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex),
+        vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eCombinedImageSampler, 1,
+                                       vk::ShaderStageFlagBits::eFragment)};
+    descriptorSetLayout = device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo(
+        vk::DescriptorSetLayoutCreateFlags(), static_cast<uint32_t>(bindings.size()), bindings.data()));
+
+    std::array<vk::DescriptorPoolSize, 2> poolSizes = {
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 2),
+        vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, 1)};
+    descriptorPool = device.createDescriptorPool(vk::DescriptorPoolCreateInfo(
+        vk::DescriptorPoolCreateFlags(), 1, static_cast<uint32_t>(poolSizes.size()), poolSizes.data()));
+
+    descriptorSet =
+        device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(descriptorPool, 1, &descriptorSetLayout))[0];
+
+    vk::DescriptorImageInfo imageInfo =
+        vk::DescriptorImageInfo(sampler, streamImages.view, vk::ImageLayout::eShaderReadOnlyOptimal);
+    vk::WriteDescriptorSet write =
+        vk::WriteDescriptorSet(descriptorSet, 2, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfo);
+    device.updateDescriptorSets(write, nullptr);
+}
+
+void WallCompositor::write_buffer_descriptors()
+{
+    std::array<vk::DescriptorBufferInfo, 2> bufferInfos = {
+        vk::DescriptorBufferInfo(tileBuffer.buffer, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(drawListBuffer.buffer, 0, VK_WHOLE_SIZE)};
+    std::array<vk::WriteDescriptorSet, 2> writes = {
+        vk::WriteDescriptorSet(descriptorSet, 0, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos[0]),
+        vk::WriteDescriptorSet(descriptorSet, 1, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos[1])};
+    engine.get_device().updateDescriptorSets(writes, nullptr);
+}
+
+void WallCompositor::make_pipeline()
+{
+    const vk::Device& device = engine.get_device();
+
+    // the wall keeps its contents between frames so unchanged tiles need no redraw
+    renderPass = make_color_render_pass(device, target.format, vk::ImageLayout::eTransferSrcOptimal,
+                                        vk::AttachmentLoadOp::eLoad);
+    vk::FramebufferCreateInfo framebufferInfo =
+        vk::FramebufferCreateInfo(vk::FramebufferCreateFlags(), renderPass, 1, &target.view, width, height, 1);
+    framebuffer = device.createFramebuffer(framebufferInfo);
+
+    vk::PushConstantRange pushConstantRange =
+        vk::PushConstantRange(vk::ShaderStageFlagBits::eVertex, 0, sizeof(CompositeParams));
+    pipelineLayout = device.createPipelineLayout(
+        vk::PipelineLayoutCreateInfo(vk::PipelineLayoutCreateFlags(), 1, &descriptorSetLayout, 1, &pushConstantRange));
+
+    pipeline = make_graphics_pipeline(device, pipelineLayout, renderPass, "compositor.vert.spv",
+                                      "compositor.frag.spv", engine.is_debug());
+}
+
+void WallCompositor::record(const vk::CommandBuffer& cmd, uint32_t drawCount)
+{
+    cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        trace->begin(cmd);
+    }
+
+    if (layoutChanged)
+    {
+        const vk::ClearColorValue black = vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f});
+        transition_image(cmd, target, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eTransferDstOptimal);
+        cmd.clearColorImage(target.image, vk::ImageLayout::eTransferDstOptimal, black,
+                            vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+        transition_image(cmd, target, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eTransferSrcOptimal);
+    }
+
+    record_uploads(cmd);
+
+    vk::RenderPassBeginInfo renderPassInfo = vk::RenderPassBeginInfo(
+        renderPass, framebuffer, vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(width, height)), 0, nullptr);
+    CompositeParams params{static_cast<float>(width), static_cast<float>(height)};
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        trace->draw(cmd, "compositor.vert.spv", "compositor.frag.spv", target,
+                    {tileBuffer.buffer, drawListBuffer.buffer}, streamImages.image, &params, sizeof(params), 6,
+                    drawCount);
+    }
+    cmd.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+    if (drawCount > 0)
+    {
+        cmd.setViewport(0,
+                        vk::Viewport(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f, 1.0f));
+        cmd.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(width, height)));
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, descriptorSet, nullptr);
+        cmd.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(params), &params);
+        cmd.draw(6, drawCount, 0, 0);
+    }
+    cmd.endRenderPass();
+
+    // copy the wall out for headless readback
+    vk::BufferImageCopy region = vk::BufferImageCopy(
+        0, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), vk::Offset3D(0, 0, 0),
+        vk::Extent3D(width, height, 1));
+    cmd.copyImageToBuffer(target.image, vk::ImageLayout::eTransferSrcOptimal, readbackBuffer.buffer, region);
+
+    vk::MemoryBarrier hostBarrier =
+        vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+                        vk::DependencyFlags(), hostBarrier, nullptr, nullptr);
+
+    cmd.end();
+}
+
+void WallCompositor::record_uploads(const vk::CommandBuffer& cmd)
+{
+    // upload every queued frame with a single copy
+    const vk::DeviceSize             layerSize = bytesPerTexel * streamExtent.width * streamExtent.height;
+    std::vector<vk::BufferImageCopy> regions;
+    for (uint32_t stream = 0; stream < streamCount; stream++)
+    {
+        if (pendingUploads[stream])
+        {
+            regions.emplace_back(layerSize * stagingSlice[stream], 0, 0,
+                                 vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, stream, 1),
+                                 vk::Offset3D(0, 0, 0), vk::Extent3D(streamExtent.width, streamExtent.height, 1));
+            pendingUploads[stream] = false;
+            Telemetry::instance().set_queue_depth(stream, 0);
+        }
+    }
+    // the submission is waited for before the next update_stream, so the slices can be reused
+    usedSlices = 0;
+    if (!regions.empty())
+    {
+        transition_image(cmd, streamImages, vk::ImageLayout::eShaderReadOnlyOptimal,
+                         vk::ImageLayout::eTransferDstOptimal);
+        cmd.copyBufferToImage(stagingBuffer.buffer, streamImages.image, vk::ImageLayout::eTransferDstOptimal, regions);
+        if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+        {
+            trace->copy(cmd, stagingBuffer.buffer, streamImages.image, regions);
+        }
+        transition_image(cmd, streamImages, vk::ImageLayout::eTransferDstOptimal,
+                         vk::ImageLayout::eShaderReadOnlyOptimal);
+    }
+}
+
+void WallCompositor::flush_uploads()
+{
+    const vk::Device& device = engine.get_device();
+
+    commandBuffer.reset();
+    commandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    if (const std::shared_ptr<CommandTrace> trace = engine.get_trace())
+    {
+        trace->begin(commandBuffer);
+    }
+    record_uploads(commandBuffer);
+    commandBuffer.end();
+
+    vk::SubmitInfo submitInfo = vk::SubmitInfo(0, nullptr, nullptr, 1, &commandBuffer);
+    engine.submit(submitInfo, fence);
+    (void)device.waitForFences(fence, VK_TRUE, UINT64_MAX);
+    device.resetFences(fence);
+}
+} // namespace vtpl
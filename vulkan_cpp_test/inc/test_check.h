@@ -0,0 +1,43 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#pragma once
+#ifndef test_check_h
+#define test_check_h
+#include <iostream>
+#include <string>
+
+namespace vtpl::test
+{
+// number of failed checks, a test exits with a failure when it is not zero
+inline int failures = 0;
+
+/**
+    Report a failed condition without stopping the test, so one run shows every failure.
+*/
+inline void check(bool condition, const std::string& what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+/**
+    \returns the exit code of the test
+*/
+inline int result()
+{
+    if (failures != 0)
+    {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
+} // namespace vtpl::test
+
+#endif // test_check_h
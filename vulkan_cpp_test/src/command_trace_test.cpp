@@ -0,0 +1,247 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "command_trace.h"
+#include "test_check.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+// fake handles, the trace only uses them as keys; a buffer and an image may share one
+const vk::Buffer        flagsBuffer = vk::Buffer(reinterpret_cast<VkBuffer>(uintptr_t{0x10}));
+const vk::Buffer        frameBuffer = vk::Buffer(reinterpret_cast<VkBuffer>(uintptr_t{0x20}));
+const vk::Buffer        untracedBuffer = vk::Buffer(reinterpret_cast<VkBuffer>(uintptr_t{0x30}));
+const vk::Image         streamImage = vk::Image(reinterpret_cast<VkImage>(uintptr_t{0x10}));
+const vk::Image         wallImage = vk::Image(reinterpret_cast<VkImage>(uintptr_t{0x40}));
+const vk::CommandBuffer uploadCommands = vk::CommandBuffer(reinterpret_cast<VkCommandBuffer>(uintptr_t{0x50}));
+const vk::CommandBuffer drawCommands = vk::CommandBuffer(reinterpret_cast<VkCommandBuffer>(uintptr_t{0x60}));
+
+/**
+    \returns whether reading the whole trace throws std::runtime_error
+*/
+bool read_fails(const std::string& path)
+{
+    try
+    {
+        vtpl::TraceReader reader(path);
+        vtpl::TraceRecord record;
+        while (reader.next(record))
+        {
+        }
+    }
+    catch (const std::runtime_error&)
+    {
+        return true;
+    }
+    return false;
+}
+} // namespace
+
+/*
+ * Writes a trace with every kind of record, reads it back and checks each field, checks that
+ * commands land at the submissions of their command buffer, then checks that files which are
+ * not complete traces or claim more data than they hold are rejected. Needs no Vulkan device.
+ *
+ * usage: vulkan_trace_test <scratch file>
+ */
+int main(int argc, char const* argv[])
+{
+    using vtpl::TraceOp;
+    using vtpl::test::check;
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <scratch file>" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::string path = argv[1];
+
+    const std::vector<uint32_t> flags = {1, 3, 0, 1};
+    const std::vector<uint8_t>  frame(vtpl::CommandTrace::inlineLimit + 1, 7);
+    const std::vector<uint32_t> drawList(vtpl::CommandTrace::inlineLimit / sizeof(uint32_t) + 1, 5);
+    const uint32_t              push[2] = {5, 6};
+    const float                 targetSize[2] = {1920.0f, 1080.0f};
+
+    vtpl::Image streams;
+    streams.image = streamImage;
+    streams.format = vk::Format::eR8G8B8A8Unorm;
+    streams.extent = vk::Extent2D(64, 32);
+    streams.arrayLayers = 4;
+    vtpl::Image wall;
+    wall.image = wallImage;
+    wall.format = vk::Format::eB8G8R8A8Unorm;
+    wall.extent = vk::Extent2D(1920, 1080);
+
+    const std::vector<vk::BufferImageCopy> regions = {
+        vk::BufferImageCopy(0, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 2, 1),
+                            vk::Offset3D(0, 0, 0), vk::Extent3D(64, 32, 1)),
+        vk::BufferImageCopy(8192, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 3, 1),
+                            vk::Offset3D(4, 2, 0), vk::Extent3D(60, 30, 1))};
+
+    {
+        vtpl::CommandTrace trace(path);
+        trace.create_buffer(flagsBuffer, 1024, vk::BufferUsageFlagBits::eStorageBuffer,
+                            vk::MemoryPropertyFlagBits::eDeviceLocal);
+        trace.create_buffer(frameBuffer, 1 << 20, vk::BufferUsageFlagBits::eTransferSrc,
+                            vk::MemoryPropertyFlagBits::eHostVisible);
+        trace.create_image(streams, vk::ImageUsageFlagBits::eSampled);
+        trace.create_image(wall, vk::ImageUsageFlagBits::eColorAttachment);
+
+        // commands are written with the submission of their command buffer, not when recorded
+        trace.begin(uploadCommands);
+        trace.copy(uploadCommands, frameBuffer, streamImage, regions);
+        trace.dispatch(uploadCommands, "motion_detect_shared.comp.spv", {flagsBuffer, frameBuffer, untracedBuffer},
+                       push, sizeof(push), 4, 2, 1);
+        trace.begin(drawCommands);
+        trace.draw(drawCommands, "compositor.vert.spv", "compositor.frag.spv", wall, {flagsBuffer, frameBuffer},
+                   streamImage, targetSize, sizeof(targetSize), 6, 12);
+
+        trace.upload(flagsBuffer, 16, flags.data(), flags.size() * sizeof(uint32_t));
+        trace.upload(frameBuffer, 0, frame.data(), frame.size());
+        trace.upload(frameBuffer, 64, drawList.data(), drawList.size() * sizeof(uint32_t), true);
+        // resources created before the trace leave no upload and have id 0 elsewhere
+        trace.upload(untracedBuffer, 0, frame.data(), 8);
+        const std::array<vk::CommandBuffer, 2> both = {uploadCommands, drawCommands};
+        trace.submit(vk::SubmitInfo(0, nullptr, nullptr, 2, both.data()));
+        trace.frame();
+
+        // a command buffer submitted again runs its commands again, one begun again drops them
+        trace.submit(vk::SubmitInfo(0, nullptr, nullptr, 1, &drawCommands));
+        trace.begin(uploadCommands);
+        trace.submit(vk::SubmitInfo(0, nullptr, nullptr, 1, &uploadCommands));
+        trace.destroy(streamImage);
+        trace.destroy(flagsBuffer);
+        // destroyed twice, or never traced
+        trace.destroy(flagsBuffer);
+        trace.destroy(untracedBuffer);
+    }
+
+    std::vector<vtpl::TraceRecord> records;
+    try
+    {
+        vtpl::TraceReader reader(path);
+        vtpl::TraceRecord record;
+        while (reader.next(record))
+        {
+            records.push_back(record);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        check(false, std::string("reading the trace back: ") + e.what());
+    }
+
+    const std::vector<TraceOp> ops = {TraceOp::CreateBuffer, TraceOp::CreateBuffer, TraceOp::CreateImage,
+                                      TraceOp::CreateImage,  TraceOp::Upload,       TraceOp::Upload,
+                                      TraceOp::Upload,       TraceOp::CopyToImage,  TraceOp::Dispatch,
+                                      TraceOp::Draw,         TraceOp::Submit,       TraceOp::Frame,
+                                      TraceOp::Draw,         TraceOp::Submit,       TraceOp::Submit,
+                                      TraceOp::Destroy,      TraceOp::Destroy};
+    check(records.size() == ops.size(), std::to_string(records.size()) + " records read back");
+    if (records.size() != ops.size())
+    {
+        return vtpl::test::result();
+    }
+    for (size_t i = 0; i < ops.size(); i++)
+    {
+        check(records[i].op == ops[i], "operation of record " + std::to_string(i));
+    }
+
+    check(records[0].id == 1 && records[0].size == 1024 &&
+              records[0].usage == static_cast<uint32_t>(vk::BufferUsageFlagBits::eStorageBuffer) &&
+              records[0].properties == static_cast<uint32_t>(vk::MemoryPropertyFlagBits::eDeviceLocal),
+          "buffer creation");
+    check(records[1].id == 2 && records[1].size == (1 << 20), "second buffer creation");
+    check(records[2].id == 3 && records[2].extent == streams.extent && records[2].format == streams.format &&
+              records[2].arrayLayers == 4 && records[2].mipLevels == 1 &&
+              records[2].usage == static_cast<uint32_t>(vk::ImageUsageFlagBits::eSampled),
+          "image creation, a buffer with the same handle gets its own id");
+    check(records[3].id == 4, "second image creation");
+
+    const vtpl::TraceRecord& small = records[4];
+    check(small.id == 1 && small.offset == 16 && small.size == flags.size() * sizeof(uint32_t) &&
+              small.data.size() == small.size &&
+              std::equal(small.data.begin(), small.data.end(), reinterpret_cast<const uint8_t*>(flags.data())),
+          "a small upload keeps its payload");
+    check(small.hash == vtpl::payload_hash(flags.data(), flags.size() * sizeof(uint32_t)), "upload hash");
+    check(records[5].id == 2 && records[5].size == frame.size() && records[5].data.empty() &&
+              records[5].hash == vtpl::payload_hash(frame.data(), frame.size()),
+          "a large upload keeps only its size and hash");
+    check(records[6].offset == 64 && records[6].data.size() == drawList.size() * sizeof(uint32_t) &&
+              std::equal(records[6].data.begin(), records[6].data.end(),
+                         reinterpret_cast<const uint8_t*>(drawList.data())),
+          "a large upload marked to be stored keeps its payload");
+
+    const vtpl::TraceRecord& copy = records[7];
+    check(copy.id == 2 && copy.target == 3 && copy.regions.size() == regions.size(), "copy resources");
+    for (size_t i = 0; i < regions.size() && i < copy.regions.size(); i++)
+    {
+        check(copy.regions[i] == regions[i], "copy region " + std::to_string(i));
+    }
+
+    const vtpl::TraceRecord& dispatch = records[8];
+    check(dispatch.shader == "motion_detect_shared.comp.spv", "dispatch shader");
+    check(dispatch.bindings == std::vector<uint32_t>{1, 2, 0}, "dispatch bindings, 0 for an untraced buffer");
+    check(dispatch.pushConstants.size() == sizeof(push) &&
+              std::equal(dispatch.pushConstants.begin(), dispatch.pushConstants.end(),
+                         reinterpret_cast<const uint8_t*>(push)),
+          "dispatch push constants");
+    check(dispatch.groups == std::array<uint32_t, 3>{4, 2, 1}, "dispatch group counts");
+
+    const vtpl::TraceRecord& draw = records[9];
+    check(draw.shader == "compositor.vert.spv" && draw.fragmentShader == "compositor.frag.spv", "draw shaders");
+    check(draw.target == 4 && draw.format == wall.format && draw.extent == wall.extent, "draw target");
+    check(draw.bindings == std::vector<uint32_t>{1, 2} && draw.sampled == 3, "draw bindings");
+    check(draw.pushConstants.size() == sizeof(targetSize), "draw push constants");
+    check(draw.vertexCount == 6 && draw.instanceCount == 12, "draw size");
+
+    check(records[10].commandBufferCount == 2, "submit");
+    check(records[12].instanceCount == 12 && records[13].commandBufferCount == 1, "a resubmission repeats the draw");
+    check(records[14].commandBufferCount == 1, "a command buffer begun again is submitted without its old commands");
+    check(records[15].id == 3 && records[16].id == 1, "each traced resource is destroyed once");
+
+    // a trace cut short, and a file which is no trace at all
+    const std::string cutPath = path + ".cut";
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::ofstream out(cutPath, std::ios::binary | std::ios::trunc);
+        std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size() - 3));
+    }
+    check(read_fails(cutPath), "a trace cut short is rejected");
+    {
+        std::ofstream out(cutPath, std::ios::binary | std::ios::trunc);
+        out << "not a trace";
+    }
+    check(read_fails(cutPath), "a file which is no trace is rejected");
+    {
+        // an upload claiming a payload of a terabyte in a file of a few bytes
+        std::ofstream out(cutPath, std::ios::binary | std::ios::trunc);
+        out.write("VTRC", 4);
+        const uint32_t version = vtpl::CommandTrace::version;
+        out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+        const auto     op = static_cast<uint8_t>(TraceOp::Upload);
+        const uint32_t id = 1;
+        const uint64_t offsetSizeHash[3] = {0, uint64_t{1} << 40, 0};
+        const uint8_t  stored = 1;
+        out.write(reinterpret_cast<const char*>(&op), sizeof(op));
+        out.write(reinterpret_cast<const char*>(&id), sizeof(id));
+        out.write(reinterpret_cast<const char*>(offsetSizeHash), sizeof(offsetSizeHash));
+        out.write(reinterpret_cast<const char*>(&stored), sizeof(stored));
+        out.write("payload", 7);
+    }
+    check(read_fails(cutPath), "a record claiming more data than the file holds is rejected");
+    std::filesystem::remove(cutPath);
+
+    return vtpl::test::result();
+}
@@ -0,0 +1,150 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "engine.h"
+#include "motion_detector.h"
+#include "submission_queue.h"
+#include "test_check.h"
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t streamCount = 3;
+constexpr uint32_t frameCount = 6;
+
+vtpl::MotionConfig test_config()
+{
+    vtpl::MotionConfig config;
+    config.width = 160;
+    config.height = 96;
+    config.zonesX = 3;
+    config.zonesY = 2;
+    config.threshold = 12;
+    config.learningDivisor = 4;
+    return config;
+}
+
+/**
+    Luma of a stream at a frame: a fixed texture with a bright square which moves by stream
+    dependent steps, stream 2 stays still so it must never report motion.
+*/
+std::vector<uint8_t> make_luma(const vtpl::MotionConfig& config, uint32_t stream, uint32_t frame)
+{
+    std::vector<uint8_t> luma(static_cast<size_t>(config.width) * config.height);
+    const uint32_t       step = stream == 2 ? 0 : 12 + stream * 9;
+    const uint32_t       left = (8 + frame * step) % (config.width - 32);
+    const uint32_t       top = (4 + frame * step / 2) % (config.height - 24);
+    for (uint32_t y = 0; y < config.height; y++)
+    {
+        for (uint32_t x = 0; x < config.width; x++)
+        {
+            const bool inside = x >= left && x < left + 32 && y >= top && y < top + 24;
+            luma[static_cast<size_t>(y) * config.width + x] =
+                inside ? 230 : static_cast<uint8_t>(40 + ((x * 7 + y * 13) % 23));
+        }
+    }
+    return luma;
+}
+
+/**
+    Feed the same frames to a detector and to the CPU reference and compare every zone.
+*/
+void compare(Engine& engine, vtpl::MotionReduction reduction, const std::string& name,
+             vtpl::SubmissionQueue* submissionQueue = nullptr)
+{
+    const vtpl::MotionConfig config = test_config();
+    const uint32_t           zoneCount = config.zonesX * config.zonesY;
+
+    std::unique_ptr<vtpl::MotionDetector> detector;
+    try
+    {
+        detector = std::make_unique<vtpl::MotionDetector>(engine, streamCount, config, reduction, submissionQueue);
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cout << "Skipping the " << name << " reduction: " << e.what() << std::endl;
+        return;
+    }
+
+    std::vector<std::vector<uint32_t>> backgrounds(streamCount);
+    uint64_t                           moving = 0;
+    for (uint32_t frame = 0; frame < frameCount; frame++)
+    {
+        std::vector<std::vector<uint32_t>> expected(streamCount);
+        for (uint32_t stream = 0; stream < streamCount; stream++)
+        {
+            const std::vector<uint8_t> luma = make_luma(config, stream, frame);
+            detector->submit_luma(stream, luma.data());
+            expected[stream] = vtpl::motion_reference(config, luma.data(), backgrounds[stream], frame == 0);
+        }
+        detector->detect();
+
+        for (uint32_t stream = 0; stream < streamCount; stream++)
+        {
+            const uint32_t* counts = detector->zone_counts(stream);
+            for (uint32_t zone = 0; zone < zoneCount; zone++)
+            {
+                vtpl::test::check(counts[zone] == expected[stream][zone],
+                                  name + " frame " + std::to_string(frame) + " stream " + std::to_string(stream) +
+                                      " zone " + std::to_string(zone) + ": " + std::to_string(counts[zone]) +
+                                      " changed pixels, reference " + std::to_string(expected[stream][zone]));
+                // a zone is flagged as moving once any of its pixels changed
+                vtpl::test::check((detector->zone_score(stream, zone) > 0.0f) == (expected[stream][zone] > 0),
+                                  name + " frame " + std::to_string(frame) + " stream " + std::to_string(stream) +
+                                      " zone " + std::to_string(zone) + " motion flag");
+                moving += counts[zone];
+            }
+        }
+    }
+    vtpl::test::check(moving > 0, name + " reduction saw motion at all");
+    for (uint32_t zone = 0; zone < zoneCount; zone++)
+    {
+        vtpl::test::check(detector->zone_counts(2)[zone] == 0, name + " still stream has no motion");
+    }
+}
+
+void expect_rejected(Engine& engine, const std::function<void(vtpl::MotionConfig&)>& change, const std::string& what)
+{
+    vtpl::MotionConfig config = test_config();
+    change(config);
+    try
+    {
+        vtpl::MotionDetector detector(engine, 1, config);
+        vtpl::test::check(false, what + " is rejected");
+    }
+    catch (const std::invalid_argument&)
+    {
+    }
+}
+} // namespace
+
+/*
+ * Runs the shared memory and the subgroup motion kernel on fixed luma frames and checks
+ * their zone counts and motion flags against motion_reference, frame by frame, once submitted
+ * directly and once through a submission queue. The subgroup kernel is skipped on devices
+ * without subgroup arithmetic in compute shaders.
+ */
+int main()
+{
+    std::unique_ptr<Engine> const engine(new Engine());
+
+    compare(*engine, vtpl::MotionReduction::SharedMemory, "shared memory");
+    compare(*engine, vtpl::MotionReduction::Subgroup, "subgroup");
+    {
+        vtpl::SubmissionQueue submissionQueue(*engine);
+        compare(*engine, vtpl::MotionReduction::Automatic, "queued", &submissionQueue);
+        vtpl::test::check(submissionQueue.stats().packets == frameCount, "every detect went through the queue");
+    }
+
+    expect_rejected(*engine, [](vtpl::MotionConfig& config) { config.learningDivisor = 0; }, "learningDivisor 0");
+    expect_rejected(*engine, [](vtpl::MotionConfig& config) { config.width = 162; }, "a width of 162");
+    expect_rejected(*engine, [](vtpl::MotionConfig& config) { config.height = 90; }, "a height of 90");
+    return vtpl::test::result();
+}
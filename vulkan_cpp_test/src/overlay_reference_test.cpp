@@ -0,0 +1,207 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "engine.h"
+#include "overlay_renderer.h"
+#include "test_check.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t width = 256;
+constexpr uint32_t height = 128;
+
+constexpr uint32_t red = 0xFF0000FF;
+constexpr uint32_t green = 0xFF00FF00;
+constexpr uint32_t blue = 0xFFFF0000;
+
+// channel difference and share of differing pixels tolerated against the reference
+constexpr int    channelTolerance = 8;
+constexpr double pixelTolerance = 0.005;
+
+const uint8_t* pixel(const std::vector<uint8_t>& image, uint32_t x, uint32_t y)
+{
+    return image.data() + (static_cast<size_t>(y) * width + x) * 4;
+}
+
+// a one glyph SDF atlas: a filled square covering the middle half of the atlas, 0.5 on its outline
+constexpr uint32_t atlasSize = 16;
+
+std::vector<uint8_t> make_square_sdf()
+{
+    std::vector<uint8_t> sdf(static_cast<size_t>(atlasSize) * atlasSize);
+    for (uint32_t y = 0; y < atlasSize; y++)
+    {
+        for (uint32_t x = 0; x < atlasSize; x++)
+        {
+            // signed distance in texels from the texel center to the square, negative inside
+            const float dx = std::abs(static_cast<float>(x) + 0.5f - atlasSize * 0.5f) - atlasSize * 0.25f;
+            const float dy = std::abs(static_cast<float>(y) + 0.5f - atlasSize * 0.5f) - atlasSize * 0.25f;
+            const float outside = std::sqrt(std::max(dx, 0.0f) * std::max(dx, 0.0f) +
+                                            std::max(dy, 0.0f) * std::max(dy, 0.0f));
+            const float distance = outside + std::min(std::max(dx, dy), 0.0f);
+            const float value = std::clamp(0.5f - distance / atlasSize, 0.0f, 1.0f);
+            sdf[static_cast<size_t>(y) * atlasSize + x] = static_cast<uint8_t>(value * 255.0f + 0.5f);
+        }
+    }
+    return sdf;
+}
+
+bool is_empty(const std::vector<uint8_t>& image, uint32_t x, uint32_t y)
+{
+    const uint8_t* p = pixel(image, x, y);
+    return p[0] == 0 && p[1] == 0 && p[2] == 0 && p[3] == 0;
+}
+
+// whether the pixel is dominated by one channel, 0 red, 1 green, 2 blue
+bool is_color(const std::vector<uint8_t>& image, uint32_t x, uint32_t y, int channel)
+{
+    const uint8_t* p = pixel(image, x, y);
+    for (int c = 0; c < 3; c++)
+    {
+        if ((c == channel) != (p[c] > 160))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void write_pam(const std::string& path, const std::vector<uint8_t>& image)
+{
+    std::ofstream file(path, std::ios::binary);
+    file << "P7\nWIDTH " << width << "\nHEIGHT " << height << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+    file.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size()));
+}
+
+bool read_pam(const std::string& path, std::vector<uint8_t>& image)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string   line;
+    uint32_t      fileWidth = 0;
+    uint32_t      fileHeight = 0;
+    while (std::getline(file, line) && line != "ENDHDR")
+    {
+        std::istringstream fields(line);
+        std::string        key;
+        fields >> key;
+        if (key == "WIDTH")
+        {
+            fields >> fileWidth;
+        }
+        else if (key == "HEIGHT")
+        {
+            fields >> fileHeight;
+        }
+    }
+    if (!file || fileWidth != width || fileHeight != height)
+    {
+        return false;
+    }
+    image.resize(static_cast<size_t>(width) * height * 4);
+    file.read(reinterpret_cast<char*>(image.data()), static_cast<std::streamsize>(image.size()));
+    return static_cast<bool>(file);
+}
+} // namespace
+
+/*
+ * Renders a fixed overlay offscreen and checks it twice: against properties which hold on
+ * any conformant implementation (culling, clipping, where outlines land), and against a
+ * reference image rendered earlier on the software ICD used by CI.
+ *
+ * usage: vulkan_overlay_test <reference.pam> <output.pam>
+ * The rendered frame is always written to output.pam. A missing reference fails the test; to
+ * regenerate it, render on the software ICD, review output.pam and copy it to the reference path.
+ */
+int main(int argc, char const* argv[])
+{
+    using vtpl::test::check;
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <reference.pam> <output.pam>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<Engine> const engine(new Engine());
+    vtpl::OverlayRenderer         overlay(*engine, width, height, 256, 4);
+
+    check(overlay.set_tiles({{0.0f, 0.0f, 128.0f, 128.0f}, {128.0f, 0.0f, 128.0f, 128.0f}}), "set_tiles");
+    // an outline inside the left tile, pixels 32 to 96
+    overlay.add_box(0, 0.25f, 0.25f, 0.75f, 0.75f, red, 4.0f);
+    // an outline leaving the left tile, its right part must be clipped away
+    overlay.add_box(0, 0.5f, 0.6f, 1.5f, 1.5f, blue, 4.0f);
+    // a horizontal track across the right tile at y = 64
+    overlay.add_track(1, {{0.1f, 0.5f}, {0.9f, 0.5f}}, green, 4.0f);
+    // a record for a tile which does not exist is culled
+    overlay.add_box(7, 0.0f, 0.0f, 1.0f, 1.0f, red, 4.0f);
+    // a label in the right tile with its pen at pixel (160, 48), 16 pixels per em. Every 'I' is
+    // a 16x16 quad above the baseline whose middle 8x8 pixels are covered, '?' is not in the atlas
+    const std::vector<uint8_t> sdf = make_square_sdf();
+    overlay.set_glyph_atlas(atlasSize, atlasSize, sdf.data(),
+                            {{'I', vtpl::GlyphMetrics{0.0f, 0.0f, 1.0f, 1.0f, 0.0f, -1.0f, 1.0f, 1.0f, 1.25f}}});
+    check(overlay.add_label(1, 0.25f, 0.375f, 16.0f, "I?I", blue), "add_label");
+    overlay.render();
+
+    const std::array<uint32_t, 3> counts = overlay.visible_counts();
+    check(counts[0] == 2, "two boxes survive culling, got " + std::to_string(counts[0]));
+    check(counts[1] == 1, "one segment survives culling, got " + std::to_string(counts[1]));
+    check(counts[2] == 2, "two glyphs survive culling, got " + std::to_string(counts[2]));
+
+    const std::vector<uint8_t> image = overlay.readback();
+    check(image.size() == static_cast<size_t>(width) * height * 4, "readback size");
+    write_pam(argv[2], image);
+
+    check(is_color(image, 32, 64, 0), "left edge of the red box");
+    check(is_color(image, 96, 64, 0), "right edge of the red box");
+    check(is_empty(image, 64, 64), "inside of the red box is left untouched");
+    check(is_color(image, 64, 110, 2), "left edge of the blue box");
+    check(is_empty(image, 150, 77), "blue box is clipped to its tile");
+    check(is_color(image, 192, 64, 1), "green track");
+    check(is_empty(image, 192, 100), "below the green track");
+    check(is_color(image, 168, 40, 2), "first glyph of the label");
+    check(is_empty(image, 161, 33), "corner of the first glyph quad outside its outline");
+    check(is_empty(image, 178, 40), "advance between the glyphs");
+    check(is_color(image, 188, 40, 2), "second glyph of the label, the missing one is skipped");
+
+    const std::string referencePath = argv[1];
+    if (!std::filesystem::exists(referencePath))
+    {
+        check(false, "reference image " + referencePath + " exists, review " + argv[2] + " and copy it there");
+        return vtpl::test::result();
+    }
+
+    std::vector<uint8_t> reference;
+    check(read_pam(referencePath, reference), "reference image is a " + std::to_string(width) + "x" +
+                                                  std::to_string(height) + " RGBA PAM");
+    if (reference.size() == image.size())
+    {
+        size_t differing = 0;
+        for (size_t i = 0; i < image.size(); i += 4)
+        {
+            for (size_t c = 0; c < 4; c++)
+            {
+                const int difference = static_cast<int>(image[i + c]) - static_cast<int>(reference[i + c]);
+                if (std::abs(difference) > channelTolerance)
+                {
+                    differing++;
+                    break;
+                }
+            }
+        }
+        const double share = static_cast<double>(differing) / (static_cast<double>(width) * height);
+        check(share <= pixelTolerance, std::to_string(differing) + " pixels differ from the reference");
+    }
+    return vtpl::test::result();
+}
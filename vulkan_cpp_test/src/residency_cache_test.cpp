@@ -0,0 +1,117 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "engine.h"
+#include "gpu_memory.h"
+#include "residency_cache.h"
+#include "test_check.h"
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr vk::DeviceSize      bufferSize = 64 * 1024;
+constexpr uint32_t            budgetBuffers = 4;
+const vk::BufferUsageFlags    usage = vk::BufferUsageFlagBits::eStorageBuffer;
+const vk::MemoryPropertyFlags deviceLocal = vk::MemoryPropertyFlagBits::eDeviceLocal;
+
+using Cache = vtpl::ResidencyCache;
+
+void insert(Cache& cache, Cache::Key key)
+{
+    // the returned lease is dropped right away, so the buffer is evictable again
+    cache.insert_buffer(key, bufferSize, usage, deviceLocal);
+}
+
+bool resident(Cache& cache, Cache::Key key)
+{
+    return static_cast<bool>(cache.acquire_buffer(key));
+}
+} // namespace
+
+/*
+ * Fills a cache limited to four buffers and checks that inserts evict the least recently
+ * used buffer, that leased and pinned buffers are never evicted or erased, and that the
+ * cache goes over its budget only when everything is pinned.
+ */
+int main()
+{
+    using vtpl::test::check;
+
+    std::unique_ptr<Engine> const engine(new Engine());
+    const vk::DeviceSize          bytes = vtpl::buffer_requirements(*engine, bufferSize, usage).size;
+    Cache                         cache(*engine, 0.8f, bytes * budgetBuffers);
+
+    for (Cache::Key key = 1; key <= budgetBuffers; key++)
+    {
+        insert(cache, key);
+    }
+    check(cache.stats().evictions == 0, "four buffers fit the budget");
+
+    // recency is now 4 3 2 1, touching 1 leaves 2 as the least recently used
+    check(resident(cache, 1), "buffer 1 is resident");
+    insert(cache, 5);
+    check(cache.stats().evictions == 1, "one eviction for the fifth buffer");
+    check(!resident(cache, 2), "the least recently used buffer 2 was evicted");
+    check(resident(cache, 1), "the recently used buffer 1 was kept");
+
+    // recency is now 1 5 4 3; lease 3 and keep it as the least recently used one
+    {
+        Cache::BufferLease lease = cache.acquire_buffer(3);
+        check(static_cast<bool>(lease) && lease->buffer, "lease of buffer 3");
+        for (Cache::Key key : {4, 5, 1})
+        {
+            resident(cache, key);
+        }
+        insert(cache, 6);
+        check(!resident(cache, 4), "the least recently used buffer which is not leased was evicted");
+        check(resident(cache, 3), "the leased buffer survives");
+        check(!cache.erase(3), "a leased buffer cannot be erased");
+        bool refused = false;
+        try
+        {
+            insert(cache, 3);
+        }
+        catch (const std::runtime_error&)
+        {
+            refused = true;
+        }
+        check(refused, "a leased buffer cannot be replaced");
+    }
+    check(cache.erase(3), "the buffer can be erased once its lease is gone");
+
+    // a pin of its own outlives the lease
+    cache.insert_buffer(7, bufferSize, usage, deviceLocal, true);
+    check(!cache.erase(7), "a pinned buffer cannot be erased");
+    cache.unpin(7);
+    check(cache.erase(7), "an unpinned buffer can be erased");
+
+    // with every buffer leased nothing can be evicted and the cache goes over its budget
+    std::vector<Cache::BufferLease> leases;
+    for (Cache::Key key = 10; key < 10 + budgetBuffers + 1; key++)
+    {
+        leases.push_back(cache.insert_buffer(key, bufferSize, usage, deviceLocal));
+    }
+    const vtpl::ResidencyStats stats = cache.stats();
+    check(stats.overBudget == 1, "one allocation over budget, got " + std::to_string(stats.overBudget));
+    check(stats.evictedBytes == stats.evictions * bytes, "evicted bytes match the evictions");
+    for (const Cache::BufferLease& lease : leases)
+    {
+        check(resident(cache, lease.get_key()), "leased buffer " + std::to_string(lease.get_key()) + " survives");
+    }
+
+    vk::DeviceSize cached = 0;
+    for (const vtpl::HeapUsage& heap : cache.heap_usage())
+    {
+        cached += heap.cached;
+    }
+    check(cached == bytes * (budgetBuffers + 1), "heap usage accounts for every cached buffer");
+
+    const vtpl::ResidencyStats counted = cache.stats();
+    check(counted.hits > 0 && counted.misses > 0, "hits and misses are counted");
+    return vtpl::test::result();
+}
@@ -0,0 +1,140 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "engine.h"
+#include "gpu_memory.h"
+#include "gpu_reactor.h"
+#include "gpu_task.h"
+#include "submission_queue.h"
+#include "test_check.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t       producerCount = 8;
+constexpr uint32_t       packetsPerProducer = 400;
+// every producer closes a batch with a fence this often and waits for it
+constexpr uint32_t       fenceInterval = 10;
+constexpr size_t         batchLimit = 16;
+constexpr vk::DeviceSize sliceSize = 4096;
+
+vtpl::Task<std::vector<uint8_t>> round_trip(vtpl::GpuReactor& reactor, const vtpl::Buffer& buffer,
+                                            vk::DeviceSize offset, uint8_t value)
+{
+    const std::vector<uint8_t> bytes(sliceSize, value);
+    co_await reactor.upload(buffer, offset, bytes.data(), sliceSize);
+    co_return co_await reactor.readback(buffer, offset, sliceSize);
+}
+} // namespace
+
+/*
+ * Pushes packets from many threads at once, some closed by a fence which the producer waits
+ * on, and checks that every packet is submitted exactly once and the counters add up. Then
+ * routes GpuReactor uploads and readbacks from several threads through the same queue.
+ */
+int main()
+{
+    using vtpl::test::check;
+
+    std::unique_ptr<Engine> const engine(new Engine());
+    const vk::Device&             device = engine->get_device();
+
+    vtpl::SubmissionQueue queue(*engine, std::chrono::microseconds(200), batchLimit);
+    std::atomic<uint64_t> accepted{0};
+    std::atomic<uint64_t> refused{0};
+
+    std::vector<std::thread> producers;
+    for (uint32_t producer = 0; producer < producerCount; producer++)
+    {
+        producers.emplace_back(
+            [&]
+            {
+                vk::Fence fence = device.createFence(vk::FenceCreateInfo());
+                for (uint32_t i = 1; i <= packetsPerProducer; i++)
+                {
+                    vtpl::SubmitPacket packet;
+                    packet.onSubmit = [&](vk::Result result)
+                    { (result == vk::Result::eSuccess ? accepted : refused).fetch_add(1); };
+                    if (i % fenceInterval != 0)
+                    {
+                        queue.push(std::move(packet));
+                        continue;
+                    }
+                    packet.fence = fence;
+                    queue.submit(std::move(packet));
+                    (void)device.waitForFences(fence, VK_TRUE, UINT64_MAX);
+                    device.resetFences(fence);
+                }
+                device.destroyFence(fence);
+            });
+    }
+    for (std::thread& producer : producers)
+    {
+        producer.join();
+    }
+
+    // the last packets of a producer may still be queued when it returns
+    const uint64_t total = static_cast<uint64_t>(producerCount) * packetsPerProducer;
+    const auto     deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (accepted.load() + refused.load() < total && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    check(accepted.load() == total, std::to_string(accepted.load()) + " of " + std::to_string(total) + " accepted");
+    check(refused.load() == 0, std::to_string(refused.load()) + " packets refused");
+
+    vtpl::SubmissionStats stats = queue.stats();
+    check(stats.packets == total, "stats count " + std::to_string(stats.packets) + " packets");
+    check(stats.failedPackets == 0 && stats.failedSubmits == 0, "stats count no failures");
+    check(stats.submits > 0 && stats.submits <= total, "stats count " + std::to_string(stats.submits) + " submits");
+    check(stats.maxBatch >= 1 && stats.maxBatch <= batchLimit,
+          "largest batch " + std::to_string(stats.maxBatch) + " is within the limit");
+    check(stats.meanBatch >= 1.0, "mean batch " + std::to_string(stats.meanBatch));
+    check(stats.submitsPerSecond > 0.0, "submits were made in the first interval");
+    stats = queue.stats();
+    check(stats.submitsPerSecond == 0.0, "the submit rate covers only the interval since the previous call");
+
+    // reactor jobs of several threads, each on a slice of its own
+    vtpl::Buffer buffer = vtpl::make_buffer(
+        *engine, sliceSize * producerCount,
+        vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal);
+    {
+        vtpl::GpuReactor         reactor(*engine, &queue);
+        std::vector<std::thread> workers;
+        std::atomic<uint32_t>    matching{0};
+        for (uint32_t worker = 0; worker < producerCount; worker++)
+        {
+            workers.emplace_back(
+                [&, worker]
+                {
+                    for (uint32_t round = 0; round < 10; round++)
+                    {
+                        const auto                 value = static_cast<uint8_t>(worker * 16 + round);
+                        const std::vector<uint8_t> bytes =
+                            vtpl::sync_wait(round_trip(reactor, buffer, sliceSize * worker, value));
+                        if (bytes == std::vector<uint8_t>(sliceSize, value))
+                        {
+                            matching.fetch_add(1);
+                        }
+                    }
+                });
+        }
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+        check(matching.load() == producerCount * 10,
+              std::to_string(matching.load()) + " reactor round trips through the queue read back their data");
+    }
+    vtpl::destroy_buffer(*engine, buffer);
+    check(queue.stats().packets > total, "the reactor submitted through the queue");
+    return vtpl::test::result();
+}
@@ -0,0 +1,125 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "engine.h"
+#include "swapchain.h"
+#include "test_check.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t frameCount = 60;
+constexpr uint32_t framesInFlight = 2;
+// time spent between acquire and present, the frame latency can be no shorter
+constexpr auto     frameWork = std::chrono::milliseconds(2);
+// returned when the driver has no headless surfaces, see SKIP_RETURN_CODE in CMakeLists.txt
+constexpr int      skipped = 77;
+
+// clear the image where the surface allows transfers and leave it ready for presentation
+void record_frame(vk::CommandBuffer commandBuffer, const vtpl::SwapchainFrame& frame, vk::ImageUsageFlags usage,
+                  uint32_t number)
+{
+    const vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+    commandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+    vk::AccessFlags access;
+    if (usage & vk::ImageUsageFlagBits::eTransferDst)
+    {
+        commandBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr,
+            vk::ImageMemoryBarrier({}, vk::AccessFlagBits::eTransferWrite, layout,
+                                   vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED,
+                                   VK_QUEUE_FAMILY_IGNORED, frame.image, range));
+        const float shade = static_cast<float>(number % frameCount) / frameCount;
+        commandBuffer.clearColorImage(frame.image, vk::ImageLayout::eTransferDstOptimal,
+                                      vk::ClearColorValue(std::array<float, 4>{shade, 0.0f, 1.0f - shade, 1.0f}),
+                                      range);
+        layout = vk::ImageLayout::eTransferDstOptimal;
+        access = vk::AccessFlagBits::eTransferWrite;
+    }
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {},
+                                  nullptr, nullptr,
+                                  vk::ImageMemoryBarrier(access, {}, layout, vk::ImageLayout::ePresentSrcKHR,
+                                                         VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                                                         frame.image, range));
+    commandBuffer.end();
+}
+} // namespace
+
+/*
+ * Presents frames to a headless surface, resizing half way, and checks the present count,
+ * the recreation and the latency and pacing statistics. A frame acquired but never submitted
+ * must not keep the swapchain from being destroyed.
+ */
+int main()
+{
+    using vtpl::test::check;
+
+    std::unique_ptr<Engine> const engine(new Engine());
+    if (!engine->has_headless_surface())
+    {
+        std::cout << "VK_EXT_headless_surface is unavailable, skipping" << std::endl;
+        return skipped;
+    }
+    const vk::Device& device = engine->get_device();
+
+    const vk::CommandPool pool = device.createCommandPool(vk::CommandPoolCreateInfo(
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer, engine->get_queue_family_index()));
+    const std::vector<vk::CommandBuffer> commandBuffers = device.allocateCommandBuffers(
+        vk::CommandBufferAllocateInfo(pool, vk::CommandBufferLevel::ePrimary, framesInFlight));
+    {
+        vtpl::Swapchain swapchain(*engine, vtpl::Swapchain::make_headless_surface(*engine), vk::Extent2D(320, 240),
+                                  vtpl::PresentMode::Fifo, 3, framesInFlight);
+        check(swapchain.get_image_count() >= 1, "the swapchain has images");
+
+        uint32_t presented = 0;
+        for (uint32_t i = 0; i < frameCount; i++)
+        {
+            if (i == frameCount / 2)
+            {
+                swapchain.resize(vk::Extent2D(160, 120));
+            }
+            const std::optional<vtpl::SwapchainFrame> frame = swapchain.acquire();
+            if (!frame)
+            {
+                continue;
+            }
+            // acquire waited for the slot's previous frame, so its command buffer is free again
+            const vk::CommandBuffer commandBuffer = commandBuffers[frame->slot];
+            record_frame(commandBuffer, *frame, swapchain.get_usage(), i);
+            std::this_thread::sleep_for(frameWork);
+            swapchain.submit(*frame, commandBuffer);
+            swapchain.present(*frame);
+            presented++;
+        }
+        check(presented == frameCount, std::to_string(presented) + " of " + std::to_string(frameCount) + " acquired");
+        check(swapchain.get_extent() == vk::Extent2D(160, 120), "the resize took effect");
+
+        const vtpl::PresentStats stats = swapchain.stats();
+        check(stats.presents == frameCount, "stats count " + std::to_string(stats.presents) + " presents");
+        check(stats.recreations == 1, "one recreation for the resize, got " + std::to_string(stats.recreations));
+        check(stats.minInterval.count() > 0 && stats.minInterval <= stats.meanInterval &&
+                  stats.meanInterval <= stats.maxInterval,
+              "present intervals are ordered, mean " + std::to_string(stats.meanInterval.count()) + " us");
+        check(stats.meanInterval >= frameWork, "frames are paced no faster than their work");
+        check(stats.intervalJitter.count() >= 0, "interval jitter is not negative");
+        check(stats.meanFrameLatency >= frameWork && stats.maxFrameLatency >= stats.meanFrameLatency,
+              "frame latency covers the frame's work, mean " + std::to_string(stats.meanFrameLatency.count()) +
+                  " us");
+
+        // dropped after acquire, the destructor below must not wait for it forever
+        const std::optional<vtpl::SwapchainFrame> dropped = swapchain.acquire();
+        check(dropped.has_value(), "a frame is acquired to be dropped");
+    }
+    device.destroyCommandPool(pool);
+    return vtpl::test::result();
+}
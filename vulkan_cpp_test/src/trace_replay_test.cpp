@@ -0,0 +1,118 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "command_trace.h"
+#include "engine.h"
+#include "motion_detector.h"
+#include "submission_queue.h"
+#include "test_check.h"
+#include "trace_replay.h"
+#include "wall_compositor.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t frameCount = 8;
+constexpr uint32_t streamCount = 2;
+constexpr uint32_t frameSize = 32;
+
+vtpl::MotionConfig test_config()
+{
+    vtpl::MotionConfig config;
+    config.width = frameSize;
+    config.height = frameSize;
+    config.zonesX = 2;
+    config.zonesY = 2;
+    return config;
+}
+
+/**
+    Composite a two tile wall and run the motion detector for a number of frames, every
+    stream getting a new frame each time. The detector submits through a SubmissionQueue,
+    so its dispatches are recorded on this thread and submitted on the queue's.
+*/
+void record_session(Engine& engine)
+{
+    vtpl::SubmissionQueue queue(engine);
+    vtpl::WallCompositor  wall(engine, frameSize * streamCount, frameSize, streamCount,
+                               vk::Extent2D(frameSize, frameSize), streamCount);
+    vtpl::MotionDetector  motion(engine, streamCount, test_config(), vtpl::MotionReduction::Automatic, &queue);
+
+    std::vector<vtpl::WallTile> tiles;
+    for (uint32_t stream = 0; stream < streamCount; stream++)
+    {
+        const auto size = static_cast<float>(frameSize);
+        tiles.push_back(vtpl::WallTile{{static_cast<float>(stream) * size, 0.0f, size, size}, stream});
+    }
+    wall.set_layout(tiles);
+
+    std::vector<uint8_t> rgba(static_cast<size_t>(frameSize) * frameSize * 4);
+    std::vector<uint8_t> luma(static_cast<size_t>(frameSize) * frameSize);
+    for (uint32_t frame = 0; frame < frameCount; frame++)
+    {
+        for (uint32_t stream = 0; stream < streamCount; stream++)
+        {
+            std::fill(rgba.begin(), rgba.end(), static_cast<uint8_t>(frame * 16 + stream));
+            std::fill(luma.begin(), luma.end(), static_cast<uint8_t>(frame * 16 + stream));
+            wall.update_stream(stream, rgba.data());
+            motion.submit_luma(stream, luma.data());
+        }
+        motion.detect();
+        wall.composite();
+    }
+}
+} // namespace
+
+/*
+ * Records a trace of the wall compositor and the motion detector, replays it twice and
+ * checks that every frame's copy, dispatch and draw is replayed with no command skipped,
+ * and that a time was measured for every frame.
+ *
+ * usage: vulkan_replay_test <scratch file>
+ */
+int main(int argc, char const* argv[])
+{
+    using vtpl::test::check;
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <scratch file>" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::string path = argv[1];
+
+    std::unique_ptr<Engine> const engine(new Engine());
+    engine->set_trace(std::make_shared<vtpl::CommandTrace>(path));
+    record_session(*engine);
+    // the trace is flushed once the engine lets go of it
+    engine->set_trace(nullptr);
+
+    vtpl::TraceReplay replay(*engine, path);
+    for (int run = 0; run < 2; run++)
+    {
+        const vtpl::ReplayStats stats = replay.run();
+        const std::string       name = "run " + std::to_string(run) + ": ";
+        check(stats.draws == frameCount, name + std::to_string(stats.draws) + " draws replayed");
+        check(stats.copies == frameCount, name + std::to_string(stats.copies) + " copies replayed");
+        check(stats.dispatches == frameCount,
+              name + std::to_string(stats.dispatches) + " dispatches replayed, including the queued ones");
+        check(stats.submits >= 2 * frameCount, name + std::to_string(stats.submits) + " submits replayed");
+        check(stats.skipped == 0, name + std::to_string(stats.skipped) + " commands skipped");
+        check(stats.uploads > 0 && stats.uploadedBytes > 0, name + "uploads replayed");
+        check(stats.frameTimes.size() == frameCount, name + std::to_string(stats.frameTimes.size()) + " frame times");
+        for (const std::chrono::nanoseconds& time : stats.frameTimes)
+        {
+            check(time.count() > 0, name + "frame time measured");
+        }
+    }
+    std::filesystem::remove(path);
+    return vtpl::test::result();
+}
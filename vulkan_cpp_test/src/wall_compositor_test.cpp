@@ -0,0 +1,160 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "engine.h"
+#include "test_check.h"
+#include "wall_compositor.h"
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t width = 64;
+constexpr uint32_t height = 64;
+constexpr uint32_t streamCount = 4;
+constexpr uint32_t tileSize = 32;
+constexpr int      channelTolerance = 2;
+
+using Color = std::array<uint8_t, 3>;
+
+std::vector<uint8_t> solid_frame(const Color& color)
+{
+    std::vector<uint8_t> frame(static_cast<size_t>(tileSize) * tileSize * 4);
+    for (size_t i = 0; i < frame.size(); i += 4)
+    {
+        frame[i] = color[0];
+        frame[i + 1] = color[1];
+        frame[i + 2] = color[2];
+        frame[i + 3] = 255;
+    }
+    return frame;
+}
+
+// a 2x2 wall, tile i at column i % 2 and row i / 2, showing the given streams
+std::vector<vtpl::WallTile> grid(const std::array<uint32_t, 4>& streams)
+{
+    std::vector<vtpl::WallTile> tiles;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        const float x = static_cast<float>(i % 2 * tileSize);
+        const float y = static_cast<float>(i / 2 * tileSize);
+        tiles.push_back(
+            vtpl::WallTile{{x, y, static_cast<float>(tileSize), static_cast<float>(tileSize)}, streams[i]});
+    }
+    return tiles;
+}
+
+// whether the center of a 2x2 grid tile shows the color
+bool tile_is(const std::vector<uint8_t>& image, uint32_t tile, const Color& color)
+{
+    const uint32_t x = tile % 2 * tileSize + tileSize / 2;
+    const uint32_t y = tile / 2 * tileSize + tileSize / 2;
+    const size_t   offset = (static_cast<size_t>(y) * width + x) * 4;
+    for (size_t c = 0; c < 3; c++)
+    {
+        if (std::abs(static_cast<int>(image[offset + c]) - static_cast<int>(color[c])) > channelTolerance)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+/*
+ * Composites a 2x2 wall headless and reads it back: only tiles whose stream got a new frame
+ * are redrawn, a layout change redraws every tile, and concurrent stream updates are safe.
+ */
+int main()
+{
+    using vtpl::test::check;
+
+    const std::array<Color, streamCount> first = {Color{255, 0, 0}, Color{0, 255, 0}, Color{0, 0, 255},
+                                                  Color{255, 255, 0}};
+    const std::array<Color, streamCount> second = {Color{0, 255, 255}, Color{255, 0, 255}, Color{128, 128, 128},
+                                                   Color{255, 255, 255}};
+    const Color                          black = {0, 0, 0};
+
+    std::unique_ptr<Engine> const engine(new Engine());
+    vtpl::WallCompositor          wall(*engine, width, height, streamCount, vk::Extent2D(tileSize, tileSize), 2);
+
+    check(!wall.set_layout(grid({0, 1, 2, 9})), "a layout with a stream past the end is refused");
+    check(wall.set_layout(grid({0, 1, 2, 3})), "set_layout");
+    check(!wall.update_stream(streamCount, solid_frame(black).data()), "a stream past the end is refused");
+
+    // every stream, more than the two staging slices, so the early upload path runs too
+    for (uint32_t stream = 0; stream < streamCount; stream++)
+    {
+        check(wall.update_stream(stream, solid_frame(first[stream]).data()), "update_stream");
+    }
+    uint32_t redrawn = wall.composite();
+    check(redrawn == 4, "the first frame draws every tile, got " + std::to_string(redrawn));
+    std::vector<uint8_t> image = wall.readback();
+    check(image.size() == static_cast<size_t>(width) * height * 4, "readback size");
+    for (uint32_t tile = 0; tile < 4; tile++)
+    {
+        check(tile_is(image, tile, first[tile]), "tile " + std::to_string(tile) + " shows its first frame");
+    }
+
+    // a subset of the streams moves on
+    wall.update_stream(1, solid_frame(second[1]).data());
+    wall.update_stream(3, solid_frame(second[3]).data());
+    redrawn = wall.composite();
+    check(redrawn == 2, "only the two updated tiles are redrawn, got " + std::to_string(redrawn));
+    image = wall.readback();
+    check(tile_is(image, 0, first[0]), "tile 0 is kept");
+    check(tile_is(image, 1, second[1]), "tile 1 shows its new frame");
+    check(tile_is(image, 2, first[2]), "tile 2 is kept");
+    check(tile_is(image, 3, second[3]), "tile 3 shows its new frame");
+
+    redrawn = wall.composite();
+    check(redrawn == 0, "nothing is redrawn without updates, got " + std::to_string(redrawn));
+    check(tile_is(wall.readback(), 0, first[0]), "the wall keeps its contents between frames");
+
+    // a layout change redraws everything, tiles left without a stream go black
+    std::vector<vtpl::WallTile> reversed = grid({3, 2, 1, 0});
+    reversed.pop_back();
+    check(wall.set_layout(reversed), "set_layout");
+    redrawn = wall.composite();
+    check(redrawn == 3, "a layout change redraws every tile, got " + std::to_string(redrawn));
+    image = wall.readback();
+    check(tile_is(image, 0, second[3]), "tile 0 shows stream 3 after the layout change");
+    check(tile_is(image, 1, first[2]), "tile 1 shows stream 2 after the layout change");
+    check(tile_is(image, 2, second[1]), "tile 2 shows stream 1 after the layout change");
+    check(tile_is(image, 3, black), "tile 3 is cleared after the layout change");
+
+    // decoder threads update their streams while the wall is composited
+    std::vector<std::thread> decoders;
+    for (uint32_t stream = 0; stream < streamCount; stream++)
+    {
+        decoders.emplace_back(
+            [&, stream]
+            {
+                const std::vector<uint8_t> frame = solid_frame(second[stream]);
+                for (int i = 0; i < 50; i++)
+                {
+                    wall.update_stream(stream, frame.data());
+                }
+            });
+    }
+    for (int i = 0; i < 20; i++)
+    {
+        wall.composite();
+    }
+    for (std::thread& decoder : decoders)
+    {
+        decoder.join();
+    }
+    wall.composite();
+    image = wall.readback();
+    check(tile_is(image, 0, second[3]), "tile 0 shows the last frame of stream 3");
+    check(tile_is(image, 1, second[2]), "tile 1 shows the last frame of stream 2");
+    check(tile_is(image, 2, second[1]), "tile 2 shows the last frame of stream 1");
+    return vtpl::test::result();
+}
@@ -0,0 +1,89 @@
+// *****************************************************
+//    Copyright 2023 Videonetics Technology Pvt Ltd
+// *****************************************************
+
+#include "engine.h"
+#include "trace_replay.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <logging.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+double to_milliseconds(std::chrono::nanoseconds duration) { return static_cast<double>(duration.count()) / 1e6; }
+
+/**
+    Log the counters of a run and the distribution of its frame times.
+*/
+void report(uint32_t run, const vtpl::ReplayStats& stats)
+{
+    std::vector<std::chrono::nanoseconds> sorted = stats.frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+
+    std::chrono::nanoseconds total{0};
+    for (std::chrono::nanoseconds frameTime : sorted)
+    {
+        total += frameTime;
+    }
+    auto quantile = [&](double q)
+    { return sorted.empty() ? 0.0 : to_milliseconds(sorted[static_cast<size_t>(q * (sorted.size() - 1))]); };
+
+    RAY_LOG_INF << "Run " << run << ": " << sorted.size() << " frames, " << stats.submits << " submits, "
+                << stats.dispatches << " dispatches, " << stats.draws << " draws, " << stats.copies
+                << " copies into images, " << stats.uploads << " uploads of " << stats.uploadedBytes << " bytes, "
+                << stats.skipped << " commands on resources from before the trace skipped";
+    if (!sorted.empty())
+    {
+        RAY_LOG_INF << "Run " << run << " frame ms: mean " << to_milliseconds(total) / sorted.size() << ", p50 "
+                    << quantile(0.5) << ", p99 " << quantile(0.99) << ", max " << to_milliseconds(sorted.back());
+    }
+}
+} // namespace
+
+/*
+ * Replays a command trace recorded with Engine::set_trace, headless and at full speed.
+ * The graphics work of the overlay renderer is not recorded, so it is not replayed either.
+ * The time of every frame is printed to standard output as "run frame milliseconds",
+ * so runs against different library or driver builds can be compared line by line.
+ */
+int main(int argc, char const* argv[])
+{
+    std::string name_of_app = "VulkanReplayExe";
+    ::ray::RayLog::StartRayLog(name_of_app, ::ray::RayLogLevel::INFO);
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <trace file> [runs]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::string tracePath = argv[1];
+    const uint32_t    runs = argc > 2 ? static_cast<uint32_t>(std::max(1, std::atoi(argv[2]))) : 1;
+
+    try
+    {
+        std::unique_ptr<Engine> const engine(new Engine());
+        vtpl::TraceReplay             replay(*engine, tracePath);
+        RAY_LOG_INF << "Replaying uploads, copies into images, dispatches and wall compositor draws; overlay draws, "
+                       "clears and copies out of images are not recorded and not part of the frame times";
+        for (uint32_t run = 0; run < runs; run++)
+        {
+            const vtpl::ReplayStats stats = replay.run();
+            for (size_t frame = 0; frame < stats.frameTimes.size(); frame++)
+            {
+                std::cout << run << ' ' << frame << ' ' << to_milliseconds(stats.frameTimes[frame]) << '\n';
+            }
+            report(run, stats);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        RAY_LOG_ERR << "Replay of \"" << tracePath << "\" failed: " << e.what();
+        return EXIT_FAILURE;
+    }
+    return 0;
+}